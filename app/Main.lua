@@ -15,6 +15,8 @@ end
 local coluster = assert(require("coluster").new())
 local services = {}
 coluster:Start(4)
+-- sample every cross-warp switch while starting up, see the trace dump below
+coluster:SetChainSampling(1)
 coluster:Post(function ()
 	print("Start!")
 	print("Initializing coluster services ...")
@@ -53,6 +55,7 @@ for i = 1, 8 do
 	print("------------------")
 end
 
+coluster:SetChainSampling(0)
 coluster:Join(function ()
 	for i = #services, 1, -1 do
 		local service = services[i]
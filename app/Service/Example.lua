@@ -2,8 +2,6 @@ local Example = {}
 Example.__index = Example
 
 local function Main(coluster, services)
-	local concurrent = require("Util/Concurrent")
-
 	local device = services.Device
 	local storage = services.Storage
 	local luabridge = services.LuaBridge
@@ -146,7 +144,7 @@ local function Main(coluster, services)
 
 				-- resource preparation
 
-				concurrent.Folk({
+				coluster:WhenAll({
 					function () theParameters:Upload(cmdBuffer, 0, bufferContent) end,
 					function () imageTexture:Upload(cmdBuffer, theImage) end
 				})
@@ -27,6 +27,8 @@ namespace coluster {
 		lua.set_current<&Channel::Close>("Close");
 		lua.set_current<&Channel::Send>("Send");
 		lua.set_current<&Channel::Recv>("Recv");
+		lua.set_current<&Channel::SetWarpAffinity>("SetWarpAffinity");
+		lua.set_current<&Channel::GetWarpStats>("GetWarpStats");
 	}
 
 	Coroutine<void> Channel::Close() noexcept {
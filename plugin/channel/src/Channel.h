@@ -15,6 +15,9 @@ namespace coluster {
 
 		static void lua_registar(LuaState lua);
 		Warp& GetWarp() noexcept { return *this; }
+		Warp* GetObjectWarp() const noexcept override { return const_cast<Channel*>(this); }
+		bool SetWarpAffinity(size_t threadIndex) noexcept { return SetObjectWarpAffinity(threadIndex); }
+		Ref GetWarpStats(LuaState lua) { return GetObjectWarpStats(lua); }
 		Coroutine<Result<bool>> Setup(std::string_view protocol, std::string_view address);
 		Coroutine<bool> Connect(std::string_view address);
 		Coroutine<bool> Send(std::string_view data);
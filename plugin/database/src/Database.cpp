@@ -9,6 +9,8 @@ namespace coluster {
 		lua.set_current<&Database::Initialize>("Initialize");
 		lua.set_current<&Database::Uninitialize>("Uninitialize");
 		lua.set_current<&Database::Execute>("Execute");
+		lua.set_current<&Database::SetWarpAffinity>("SetWarpAffinity");
+		lua.set_current<&Database::GetWarpStats>("GetWarpStats");
 	}
 
 	Coroutine<Result<bool>> Database::Initialize(std::string_view path, bool createIfNotExist) {
@@ -146,7 +148,11 @@ namespace coluster {
 		}
 	}
 
-	Coroutine<Result<Ref>> Database::Execute(LuaState lua, std::string_view sqlTemplate, Ref&& argPostData, bool asyncPost) {
+	Coroutine<Result<Ref>> Database::Execute(LuaState lua, std::string_view sqlTemplate, Ref&& argPostData, bool asyncPost, CancelToken* token) {
+		if (CancelToken::Check(token)) {
+			co_return ResultError("cancelled");
+		}
+
 		if (handle == nullptr || status == Status::Invalid) {
 			co_return ResultError("[ERROR] Database::Execute() -> Uninitialized database!");
 		}
@@ -168,6 +174,9 @@ namespace coluster {
 		Warp* currentWarp = co_await Warp::Switch(std::source_location::current(), Warp::get_current_warp(), &GetWarp());
 		std::string message;
 
+		// abort the running statement on cancellation, sqlite3_interrupt() is safe to call from any thread
+		size_t subscription = token != nullptr ? token->subscribe([this]() { sqlite3_interrupt(handle); }) : 0;
+
 		if (sqlite3_prepare_v2(handle, sqlTemplate.data(), -1, &stmt, 0) == SQLITE_OK) {
 			if (postData) {
 				lua_rawgeti(D, LUA_REGISTRYINDEX, postData.get_ref_index());
@@ -175,6 +184,10 @@ namespace coluster {
 
 				int startIndex = 1;
 				for (int i = 1; i <= size; i++) {
+					if (CancelToken::Check(token)) {
+						break;
+					}
+
 					lua_rawgeti(D, -1, i);
 
 					if (lua_istable(D, -1)) {
@@ -220,12 +233,19 @@ namespace coluster {
 			message = message + "[ERROR] Database::Execute() -> " + sqlite3_errmsg(handle) + "\n";
 		}
 
+		if (token != nullptr) {
+			token->unsubscribe(subscription);
+		}
+
 		co_await Warp::Switch(std::source_location::current(), currentWarp);
 		assert(lua_gettop(D) == 1);
 		status = Status::Ready;
 
 		lua_xmove(D, lua.get_state(), 1);
-		if (message.empty()) {
+		if (CancelToken::Check(token)) {
+			lua_pop(lua.get_state(), 1);
+			co_return ResultError("cancelled");
+		} else if (message.empty()) {
 			co_return Ref(luaL_ref(lua.get_state(), LUA_REGISTRYINDEX));
 		} else {
 			lua_pop(lua.get_state(), 1);
@@ -16,11 +16,14 @@ namespace coluster {
 	public:
 		Database(AsyncWorker& asyncWorker);
 		Warp& GetWarp() noexcept { return *this; }
+		Warp* GetObjectWarp() const noexcept override { return const_cast<Database*>(this); }
+		bool SetWarpAffinity(size_t threadIndex) noexcept { return SetObjectWarpAffinity(threadIndex); }
+		Ref GetWarpStats(LuaState lua) { return GetObjectWarpStats(lua); }
 
 		static void lua_registar(LuaState lua);
 		Coroutine<Result<bool>> Initialize(std::string_view path, bool createIfNotExist);
 		Coroutine<void> Uninitialize();
-		Coroutine<Result<Ref>> Execute(LuaState lua, std::string_view sqlTemplate, Ref&& postData, bool asyncPost);
+		Coroutine<Result<Ref>> Execute(LuaState lua, std::string_view sqlTemplate, Ref&& postData, bool asyncPost, CancelToken* token);
 		void lua_initialize(LuaState lua, int index);
 		void lua_finalize(LuaState lua, int index);
 		
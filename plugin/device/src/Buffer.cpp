@@ -53,7 +53,7 @@ namespace coluster {
 
 			size_t size = data.size();
 			// require both host memory and device memory
-			memoryQuotaResource = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ 0, size * 2 });
+			memoryQuotaResource = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ 0, size * 2 }, MemoryCategory::Buffer);
 
 			VkBufferCreateInfo bufferInfo = {};
 			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -141,7 +141,7 @@ namespace coluster {
 			device.Verify("create buffer", vmaCreateBuffer(device.GetVmaAllocator(), &bufferInfo, &vmaAllocInfo, &downloadBuffer, &downloadBufferAllocation, nullptr));
 
 			Warp* currentWarp = co_await Warp::Switch(std::source_location::current(), &cmdBuffer.get()->GetWarp());
-			auto downloadQuota = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ 0, size }); 
+			auto downloadQuota = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ 0, size }, MemoryCategory::Buffer); 
 
 			VkBufferMemoryBarrier useBarrier = {};
 			useBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
@@ -134,5 +134,7 @@ namespace coluster {
 
 	void CmdBuffer::lua_registar(LuaState lua) {
 		lua.set_current<&CmdBuffer::Submit>("Submit");
+		lua.set_current<&CmdBuffer::SetWarpAffinity>("SetWarpAffinity");
+		lua.set_current<&CmdBuffer::GetWarpStats>("GetWarpStats");
 	}
 }
@@ -20,6 +20,9 @@ namespace coluster {
 
 		VkCommandBuffer GetCommandBuffer() const noexcept { return commandBuffers[0]; }
 		Warp& GetWarp() noexcept { return *this; }
+		Warp* GetObjectWarp() const noexcept override { return const_cast<CmdBuffer*>(this); }
+		bool SetWarpAffinity(size_t threadIndex) noexcept { return SetObjectWarpAffinity(threadIndex); }
+		Ref GetWarpStats(LuaState lua) { return GetObjectWarpStats(lua); }
 
 		void Begin() noexcept;
 		void End() noexcept;
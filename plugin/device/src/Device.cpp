@@ -31,6 +31,7 @@ namespace coluster {
 	void SubmitCompletion::await_suspend(CoroutineHandle<> handle) {
 		info.handle = std::move(handle);
 		info.warp = Warp::get_current_warp();
+		submitTicks = GetLatencyTicks();
 		device.QueueSubmitCompletionOnAny(*this);
 	}
 
@@ -40,6 +41,7 @@ namespace coluster {
 	}
 
 	void SubmitCompletion::Resume() {
+		RecordLatency(LatencyType::DeviceSubmit, submitTicks);
 		Clear();
 
 		dispatch(std::move(info));
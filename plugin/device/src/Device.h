@@ -41,6 +41,7 @@ namespace coluster {
 		void await_resume() noexcept;
 
 		void Resume();
+		void* GetCoroutineAddress() const noexcept { return coroutineAddress; }
 		VkFence GetFence() const noexcept { return fence; }
 		void SetFence(VkFence f) noexcept { fence = f; }
 		std::span<VkCommandBuffer> GetCommandBuffers() const noexcept { return commandBuffers; }
@@ -54,6 +55,7 @@ namespace coluster {
 		Device& device;
 		std::span<VkCommandBuffer> commandBuffers;
 		VkFence fence;
+		uint64_t submitTicks = 0;
 		info_t info;
 	};
 
@@ -99,7 +99,7 @@ namespace coluster {
 			}
 
 			// require both host memory and device memory
-			memoryQuotaResource = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ size, size });
+			memoryQuotaResource = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ size, size }, MemoryCategory::Image);
 
 			VmaAllocationCreateInfo vmaAllocInfo = {};
 			vmaAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
@@ -198,7 +198,7 @@ namespace coluster {
 
 			Warp* currentWarp = co_await Warp::Switch(std::source_location::current(), &cmdBuffer.get()->GetWarp());
 			// require both host memory and device memory
-			auto downloadQuota = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ 0, size });
+			auto downloadQuota = co_await device.GetAsyncWorker().GetMemoryQuotaQueue().guard({ 0, size }, MemoryCategory::Image);
 
 			// Copy image to buffer
 			VkImageMemoryBarrier layoutBarrier = {};
@@ -54,7 +54,7 @@ namespace coluster {
 
 			status = Status::Reading;
 			Warp* currentWarp = co_await Warp::Switch(std::source_location::current(), static_cast<Warp*>(nullptr));
-			auto readData = co_await file.get()->Read(0, iris::iris_verify_cast<size_t>(size));
+			auto readData = co_await file.get()->Read(0, iris::iris_verify_cast<size_t>(size), nullptr);
 			assert(readData);
 			std::string_view data = readData.value();
 			int width, height;
@@ -62,7 +62,7 @@ namespace coluster {
 			if (decoded != nullptr) {
 				size_t length = width * height * 4;
 				// allocate memory resource quota before allocating
-				memoryQuotaResource = co_await storage.GetAsyncWorker().GetMemoryQuotaQueue().guard({length, 0});
+				memoryQuotaResource = co_await storage.GetAsyncWorker().GetMemoryQuotaQueue().guard({length, 0}, MemoryCategory::Texture);
 				buffer.assign(reinterpret_cast<char*>(decoded), length);
 				resolution = { width, height };
 				WebPFree(decoded);
@@ -88,7 +88,7 @@ namespace coluster {
 
 			uint8_t* output = nullptr;
 			size_t bytes = WebPEncodeLosslessRGBA(reinterpret_cast<uint8_t*>(buffer.data()), resolution.first, resolution.second, resolution.first * 4, &output);
-			auto writeResult = co_await file.get()->Write(0, std::string_view(reinterpret_cast<char*>(output), bytes));
+			auto writeResult = co_await file.get()->Write(0, std::string_view(reinterpret_cast<char*>(output), bytes), nullptr);
 			WebPFree(output);
 			status = Status::Ready;
 			co_await Warp::Switch(std::source_location::current(), currentWarp);
@@ -127,7 +127,7 @@ namespace coluster {
 		if (auto guard = write_fence()) {
 			status = Status::Uploading;
 			size_t length = (size_t)resolution.first * resolution.second * 4;
-			memoryQuotaResource = co_await storage.GetAsyncWorker().GetMemoryQuotaQueue().guard({length, 0});
+			memoryQuotaResource = co_await storage.GetAsyncWorker().GetMemoryQuotaQueue().guard({length, 0}, MemoryCategory::Texture);
 			auto downloadResult = co_await image.get()->Download(lua, std::move(cmdBuffer));
 			status = Status::Ready;
 
@@ -87,11 +87,41 @@ namespace coluster {
 		}
 	}
 
+	// token of the call running on current thread, checked by CancelHook
+	static thread_local const CancelToken* currentCancelToken = nullptr;
+	static constexpr int CANCEL_HOOK_INSTRUCTION_COUNT = 4096;
+
+	void LuaBridge::CancelHook(lua_State* L, lua_Debug* ar) {
+		if (CancelToken::Check(currentCancelToken)) {
+			luaL_error(L, "cancelled");
+		}
+	}
+
 	Coroutine<Result<StackIndex>> LuaBridge::Call(LuaState lua, Required<Object*> callable, StackIndex parameters) {
+		return CallWithToken(lua, callable, parameters, nullptr);
+	}
+
+	Coroutine<Result<StackIndex>> LuaBridge::CallCancellable(LuaState lua, Required<Object*> callable, StackIndex parameters) {
+		lua_State* L = lua.get_state();
+		if (lua_gettop(L) < parameters.index) {
+			return CallWithToken(lua, callable, parameters, nullptr);
+		}
+
+		// keep the token below the parameters so it stays referenced while the call is running
+		CancelToken* token = lua.native_get_variable<CancelToken*>(-1);
+		lua_insert(L, parameters.index);
+		return CallWithToken(lua, callable, StackIndex { parameters.dataStack, parameters.index + 1 }, token);
+	}
+
+	Coroutine<Result<StackIndex>> LuaBridge::CallWithToken(LuaState lua, Required<Object*> callable, StackIndex parameters, CancelToken* token) {
 		if (status != Status::Ready) {
 			co_return ResultError("LuaBridge not ready");
 		}
 
+		if (CancelToken::Check(token)) {
+			co_return ResultError("cancelled");
+		}
+
 		status = Status::Pending;
 		// copy parameters
 		lua_State* D = dataExchangeStack;
@@ -114,8 +144,27 @@ namespace coluster {
 
 		// make async call
 		co_await Warp::Switch(std::source_location::current(), &GetWarp());
+		if (CancelToken::Check(token)) {
+			lua_settop(T, 0);
+			co_await Warp::Switch(std::source_location::current(), currentWarp);
+			status = Status::Ready;
+			co_return ResultError("cancelled");
+		}
+
+		// interrupt running script with an error once cancelled
+		const CancelToken* lastCancelToken = currentCancelToken;
+		if (token != nullptr) {
+			currentCancelToken = token;
+			lua_sethook(T, &LuaBridge::CancelHook, LUA_MASKCOUNT, CANCEL_HOOK_INSTRUCTION_COUNT);
+		}
+
 		auto ret = target.native_call(callable.get()->GetRef(), count);
 
+		if (token != nullptr) {
+			lua_sethook(T, nullptr, 0, 0);
+			currentCancelToken = lastCancelToken;
+		}
+
 		if (ret) {
 			if (ret.value() != 0) {
 				// copy return values
@@ -138,6 +187,13 @@ namespace coluster {
 		} else {
 			co_await Warp::Switch(std::source_location::current(), currentWarp);
 			lua_settop(T, 0);
+			if (status != Status::Invalid) {
+				status = Status::Ready;
+			}
+
+			if (CancelToken::Check(token)) {
+				co_return ResultError("cancelled");
+			}
 
 			co_return ResultError("LuaBridge::Call() -> " + ret.message);
 		}
@@ -187,5 +243,8 @@ namespace coluster {
 		lua.set_current<&LuaBridge::Load>("Load");
 		lua.set_current<&LuaBridge::Get>("Get");
 		lua.set_current<&LuaBridge::Call>("Call");
+		lua.set_current<&LuaBridge::CallCancellable>("CallCancellable");
+		lua.set_current<&LuaBridge::SetWarpAffinity>("SetWarpAffinity");
+		lua.set_current<&LuaBridge::GetWarpStats>("GetWarpStats");
 	}
 }
\ No newline at end of file
@@ -21,6 +21,9 @@ namespace coluster {
 		};
 
 		Warp& GetWarp() noexcept { return *this; }
+		Warp* GetObjectWarp() const noexcept override { return const_cast<LuaBridge*>(this); }
+		bool SetWarpAffinity(size_t threadIndex) noexcept { return SetObjectWarpAffinity(threadIndex); }
+		Ref GetWarpStats(LuaState lua) { return GetObjectWarpStats(lua); }
 
 		class Object {
 		public:
@@ -37,6 +40,8 @@ namespace coluster {
 		Coroutine<Result<RefPtr<Object>>> Get(LuaState lua, std::string_view name);
 		Coroutine<Result<RefPtr<Object>>> Load(LuaState lua, std::string_view code, std::string_view name);
 		Coroutine<Result<StackIndex>> Call(LuaState lua, Required<Object*> callable, StackIndex stackIndex);
+		// the last parameter is the cancel token (or nil), same as other cancellable apis
+		Coroutine<Result<StackIndex>> CallCancellable(LuaState lua, Required<Object*> callable, StackIndex stackIndex);
 		void lua_initialize(LuaState lua, int index);
 		void lua_finalize(LuaState lua, int index);
 		static void lua_registar(LuaState lua);
@@ -44,6 +49,8 @@ namespace coluster {
 	protected:
 		void QueueDeleteObject(Ref&& object);
 		Ref FetchObjectType(LuaState lua, Warp* warp, Ref&& self);
+		Coroutine<Result<StackIndex>> CallWithToken(LuaState lua, Required<Object*> callable, StackIndex parameters, CancelToken* token);
+		static void CancelHook(lua_State* L, lua_Debug* ar);
 
 	protected:
 		std::atomic<queue_state_t> deletingObjectRoutineState = queue_state_t::idle;
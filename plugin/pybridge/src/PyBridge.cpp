@@ -86,6 +86,8 @@ namespace coluster {
 		lua.set_current<&PyBridge::Import>("Import");
 		lua.set_current<&PyBridge::Eval>("Eval");
 		lua.set_current<&PyBridge::Get>("Get");
+		lua.set_current<&PyBridge::SetWarpAffinity>("SetWarpAffinity");
+		lua.set_current<&PyBridge::GetWarpStats>("GetWarpStats");
 	}
 
 	Coroutine<Result<RefPtr<PyBridge::Object>>> PyBridge::Get(LuaState lua, std::string_view name) {
@@ -23,6 +23,9 @@ namespace coluster {
 		};
 
 		Warp& GetWarp() noexcept { return *this; }
+		Warp* GetObjectWarp() const noexcept override { return const_cast<PyBridge*>(this); }
+		bool SetWarpAffinity(size_t threadIndex) noexcept { return SetObjectWarpAffinity(threadIndex); }
+		Ref GetWarpStats(LuaState lua) { return GetObjectWarpStats(lua); }
 
 		class Object {
 		public:
@@ -9,9 +9,6 @@
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <linux/io_uring.h> // use io_uring
-static int sys_io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
-	return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
-}
 #endif
 
 namespace coluster {
@@ -108,6 +105,7 @@ namespace coluster {
 	void FileCompletion::await_suspend(CoroutineHandle<> handle) {
 		info.handle = std::move(handle);
 		info.warp = Warp::get_current_warp();
+		submitTicks = GetLatencyTicks();
 		file.GetStorage().DispatchOperation();
 	}
 
@@ -117,6 +115,7 @@ namespace coluster {
 	}
 
 	void FileCompletion::Resume() {
+		RecordLatency(LatencyType::FileIO, submitTicks);
 		dispatch(std::move(info));
 	}
 
@@ -131,14 +130,20 @@ namespace coluster {
 #else
 	void File::CompleteURing(void* completion) {
 		io_uring_cqe* cqe = reinterpret_cast<io_uring_cqe*>(completion);
-		reinterpret_cast<FileCompletion*>(cqe->user_data)->Resume();
+		// user_data of cancel requests is zero, see Storage::CancelURing()
+		if (cqe->user_data != 0) {
+			reinterpret_cast<FileCompletion*>(cqe->user_data)->Resume();
+		}
 	}
 #endif
 
-	Coroutine<Result<std::string_view>> File::Read(size_t offset, size_t length) {
+	Coroutine<Result<std::string_view>> File::Read(size_t offset, size_t length, CancelToken* token) {
 		if (status != Status::Ready)
 			co_return ResultError("[WARNING] File::Read() -> Not ready!");
 
+		if (CancelToken::Check(token))
+			co_return ResultError("cancelled");
+
 		if (length == 0)
 			co_return "";
 
@@ -153,7 +158,12 @@ namespace coluster {
 
 #ifdef _WIN32
 				if (fileHandle != nullptr) {
-					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ length, 0 });
+					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ length, 0 }, MemoryCategory::File, token);
+					if (!memoryQuotaResource) {
+						co_await Warp::Switch(std::source_location::current(), currentWarp);
+						status = Status::Ready;
+						co_return ResultError("cancelled");
+					}
 
 					buffer.resize(length);
 					DWORD bytes = 0;
@@ -166,7 +176,12 @@ namespace coluster {
 				}
 #else
 				if (fileFd > 0) {
-					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ length, 0 });
+					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ length, 0 }, MemoryCategory::File, token);
+					if (!memoryQuotaResource) {
+						co_await Warp::Switch(std::source_location::current(), currentWarp);
+						status = Status::Ready;
+						co_return ResultError("cancelled");
+					}
 
 					buffer.resize(length);
 					if ((length = pread(fileFd, buffer.data(), length, offset)) != 0) {
@@ -177,10 +192,16 @@ namespace coluster {
 				co_await Warp::Switch(std::source_location::current(), currentWarp);
 			} else {
 				FileCompletion completion(std::source_location::current(), *this);
+				size_t subscription = 0;
 
 #ifdef _WIN32
 				if (fileHandle != nullptr) {
-					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ sizeof(Overlapped) + length, 0 });
+					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ sizeof(Overlapped) + length, 0 }, MemoryCategory::File, token);
+					if (!memoryQuotaResource) {
+						status = Status::Ready;
+						co_return ResultError("cancelled");
+					}
+
 					buffer.resize(sizeof(Overlapped) + length);
 					Overlapped* overlapped = reinterpret_cast<Overlapped*>(buffer.data());
 					memset(overlapped, 0, sizeof(Overlapped));
@@ -200,7 +221,12 @@ namespace coluster {
 				}
 #else
 				if (fileFd != 0) {
-					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ sizeof(iovec) + length, 0 });
+					memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ sizeof(iovec) + length, 0 }, MemoryCategory::File, token);
+					if (!memoryQuotaResource) {
+						status = Status::Ready;
+						co_return ResultError("cancelled");
+					}
+
 					buffer.resize(sizeof(iovec) + length);
 
 					auto* data = buffer.data() + sizeof(iovec);
@@ -209,31 +235,22 @@ namespace coluster {
 					v->iov_len = length;
 					v->iov_base = data;
 
-					Storage::URing& uring = storage.GetURing();
-
-					uint32_t tail = *uring.submission.tail;
-					if (((tail + 1 - *uring.submission.head) & *uring.submission.ring_mask) == 0) {
-						// wait for at least one completion if full
-						sys_io_uring_enter(uring.uringFd, 0, 1, IORING_ENTER_SQ_WAIT);
-					}
-
-					uint32_t index = tail & *uring.submission.ring_mask;
-					io_uring_sqe& sqe = uring.submission.sqes[index];
+					io_uring_sqe sqe;
+					memset(&sqe, 0, sizeof(sqe));
 					sqe.fd = fileFd;
 					sqe.flags = 0;
 					sqe.opcode = IORING_OP_READV;
 					sqe.addr = reinterpret_cast<size_t>(v);
 					sqe.len = 1;
-					sqe.off = 0;
+					sqe.off = offset; // positional, the file pointer is never used
 					sqe.user_data = reinterpret_cast<size_t>(&completion);
-					uring.submission.array[index] = index;
-
-					std::atomic_thread_fence(std::memory_order_release);
-					*uring.submission.tail = tail + 1;
+					storage.SubmitURing(sqe);
 
-					std::atomic_thread_fence(std::memory_order_acquire);
-					if (*uring.submission.flags & IORING_SQ_NEED_WAKEUP) {
-						sys_io_uring_enter(uring.uringFd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+					// unlink the pending request from io_uring on cancellation
+					if (token != nullptr) {
+						subscription = token->subscribe([this, &completion]() {
+							storage.CancelURing(&completion);
+						});
 					}
 
 					result = std::string_view(data, length);
@@ -243,19 +260,30 @@ namespace coluster {
 				if (result.size() == length) {
 					Warp* currentWarp = Warp::get_current_warp();
 					co_await completion; // wait for io completion
+					if (token != nullptr) {
+						token->unsubscribe(subscription);
+					}
+
 					co_await Warp::Switch(std::source_location::current(), currentWarp);
 				}
 			}
 		}
 
 		status = Status::Ready;
+		if (CancelToken::Check(token)) {
+			co_return ResultError("cancelled");
+		}
+
 		co_return std::move(result);
 	}
 
-	Coroutine<Result<size_t>> File::Write(size_t offset, std::string_view input) {
+	Coroutine<Result<size_t>> File::Write(size_t offset, std::string_view input, CancelToken* token) {
 		if (status != Status::Ready)
 			co_return ResultError("[WARNING] File::Write() -> Not ready!");
 
+		if (CancelToken::Check(token))
+			co_return ResultError("cancelled");
+
 		if (input.size() == 0)
 			co_return 0u;
 
@@ -271,7 +299,7 @@ namespace coluster {
 				if (fileHandle != nullptr) {
 					DWORD bytes = 0;
 					LARGE_INTEGER li;
-					li.QuadPart = input.size();
+					li.QuadPart = offset; // write at the given offset, not at the end of data
 					::SetFilePointer(fileHandle, li.LowPart, &li.HighPart, FILE_BEGIN);
 
 					if (::WriteFile(fileHandle, input.data(), iris::iris_verify_cast<DWORD>(input.size()), &bytes, nullptr)) {
@@ -289,6 +317,7 @@ namespace coluster {
 				co_await Warp::Switch(std::source_location::current(), currentWarp);
 			} else {
 				FileCompletion completion(std::source_location::current(), *this);
+				size_t subscription = 0;
 #ifdef _WIN32
 				if (fileHandle != nullptr) {
 					size_t size = input.size();
@@ -324,31 +353,22 @@ namespace coluster {
 					v->iov_len = size;
 					v->iov_base = data;
 
-					Storage::URing& uring = storage.GetURing();
-
-					uint32_t tail = *uring.submission.tail;
-					if (((tail + 1 - *uring.submission.head) & *uring.submission.ring_mask) == 0) {
-						// wait for at least one completion if full
-						sys_io_uring_enter(uring.uringFd, 0, 1, IORING_ENTER_SQ_WAIT);
-					}
-
-					uint32_t index = tail & *uring.submission.ring_mask;
-					io_uring_sqe& sqe = uring.submission.sqes[index];
+					io_uring_sqe sqe;
+					memset(&sqe, 0, sizeof(sqe));
 					sqe.fd = fileFd;
 					sqe.flags = 0;
 					sqe.opcode = IORING_OP_WRITEV;
 					sqe.addr = reinterpret_cast<size_t>(v);
 					sqe.len = 1;
-					sqe.off = 0;
+					sqe.off = offset; // positional, the file pointer is never used
 					sqe.user_data = reinterpret_cast<size_t>(&completion);
-					uring.submission.array[index] = index;
-
-					std::atomic_thread_fence(std::memory_order_release);
-					*uring.submission.tail = tail + 1;
+					storage.SubmitURing(sqe);
 
-					std::atomic_thread_fence(std::memory_order_acquire);
-					if (*uring.submission.flags & IORING_SQ_NEED_WAKEUP) {
-						sys_io_uring_enter(uring.uringFd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+					// unlink the pending request from io_uring on cancellation
+					if (token != nullptr) {
+						subscription = token->subscribe([this, &completion]() {
+							storage.CancelURing(&completion);
+						});
 					}
 
 					result = size;
@@ -357,12 +377,20 @@ namespace coluster {
 				if (result != 0) {
 					Warp* currentWarp = Warp::get_current_warp();
 					co_await completion; // wait for io completion
+					if (token != nullptr) {
+						token->unsubscribe(subscription);
+					}
+
 					co_await Warp::Switch(std::source_location::current(), currentWarp);
 				}
 			}
 		}
 
 		status = Status::Ready;
+		if (CancelToken::Check(token)) {
+			co_return ResultError("cancelled");
+		}
+
 		co_return std::move(result);
 	}
 
@@ -18,10 +18,12 @@ namespace coluster {
 		void await_resume() noexcept;
 		void await_suspend(CoroutineHandle<> handle);
 		void Resume();
+		void* GetCoroutineAddress() const noexcept { return coroutineAddress; }
 
 		Warp* warp;
 		void* coroutineAddress;
 		File& file;
+		uint64_t submitTicks = 0;
 		info_t info;
 	};
 
@@ -40,8 +42,8 @@ namespace coluster {
 		static void lua_registar(LuaState lua);
 
 		STORAGE_API Coroutine<Result<bool>> Open(std::string_view path, bool write);
-		STORAGE_API Coroutine<Result<size_t>> Write(size_t offset, std::string_view data);
-		STORAGE_API Coroutine<Result<std::string_view>> Read(size_t offset, size_t length);
+		STORAGE_API Coroutine<Result<size_t>> Write(size_t offset, std::string_view data, CancelToken* token);
+		STORAGE_API Coroutine<Result<std::string_view>> Read(size_t offset, size_t length, CancelToken* token);
 		STORAGE_API Result<bool> Flush();
 
 		STORAGE_API uint64_t GetSize() const;
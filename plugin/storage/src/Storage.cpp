@@ -12,6 +12,9 @@ static constexpr uint32_t URING_QUEUE_DEPTH = 1;
 static int sys_io_uring_setup(uint32_t entries, struct io_uring_params* p) {
 	return (int)syscall(__NR_io_uring_setup, entries, p);
 }
+static int sys_io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+	return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
 #endif
 
 namespace coluster {
@@ -179,6 +182,42 @@ namespace coluster {
 		}
 	}
 
+#ifndef _WIN32
+	void Storage::SubmitURing(const io_uring_sqe& request) {
+		std::lock_guard<std::mutex> guard(submissionLock);
+		uint32_t tail = *uring.submission.tail;
+		if (((tail + 1 - *uring.submission.head) & *uring.submission.ring_mask) == 0) {
+			// wait for at least one completion if full
+			sys_io_uring_enter(uring.uringFd, 0, 1, IORING_ENTER_SQ_WAIT);
+		}
+
+		uint32_t index = tail & *uring.submission.ring_mask;
+		uring.submission.sqes[index] = request;
+		uring.submission.array[index] = index;
+
+		std::atomic_thread_fence(std::memory_order_release);
+		*uring.submission.tail = tail + 1;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (*uring.submission.flags & IORING_SQ_NEED_WAKEUP) {
+			sys_io_uring_enter(uring.uringFd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+		}
+	}
+
+	// cancel a pending request by its user_data, the cancelled request completes with -ECANCELED
+	void Storage::CancelURing(void* userData) {
+		io_uring_sqe sqe;
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.fd = -1;
+		sqe.opcode = IORING_OP_ASYNC_CANCEL;
+		sqe.addr = reinterpret_cast<size_t>(userData);
+		sqe.user_data = 0; // completion of cancel request itself, skipped by File::CompleteURing()
+
+		SubmitURing(sqe);
+		DispatchOperation();
+	}
+#endif
+
 	void Storage::Poll() {
 #ifdef _WIN32
 		DWORD interval = INFINITE;
@@ -71,6 +71,10 @@ namespace coluster {
 		uint64_t RemoveAll(std::string_view path);
 		void Rename(std::string_view oldName, std::string_view newName);
 		void DispatchOperation();
+#ifndef _WIN32
+		void SubmitURing(const io_uring_sqe& request);
+		void CancelURing(void* userData);
+#endif
 
 		AsyncWorker& GetAsyncWorker() noexcept {
 			return asyncWorker;
@@ -102,6 +106,7 @@ namespace coluster {
 		void* completionPort;
 #else
 		URing uring;
+		std::mutex submissionLock;
 #endif
 		bool supportAsyncIO = true;
 	};
@@ -1,10 +1,158 @@
 #include "Trace.h"
+#include "../../storage/src/File.h"
+#include <algorithm>
 
 namespace coluster {
 	Trace::Trace(AsyncWorker& asyncWorker) : Warp(asyncWorker) {}
 	Trace::~Trace() noexcept {}
 
 	void Trace::lua_initialize(LuaState lua, int index) {}
-	void Trace::lua_finalize(LuaState lua, int index) {}
-	void Trace::lua_registar(LuaState lua) {}
+	void Trace::lua_finalize(LuaState lua, int) {
+		Stop();
+		get_async_worker().Synchronize(lua, this);
+		lua.deref(std::move(targetFile));
+	}
+
+	void Trace::lua_registar(LuaState lua) {
+		lua.set_current<&Trace::Start>("Start");
+		lua.set_current<&Trace::Stop>("Stop");
+		lua.set_current<&Trace::IsRunning>("IsRunning");
+		lua.set_current<&Trace::Flush>("Flush");
+		lua.set_current<&Trace::GetDroppedCount>("GetDroppedCount");
+	}
+
+	bool Trace::Start() {
+		if (IsTraceEnabled()) {
+			return false;
+		}
+
+		startTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		droppedCount = 0;
+		EnableTrace(true);
+		return true;
+	}
+
+	bool Trace::Stop() {
+		if (!IsTraceEnabled()) {
+			return false;
+		}
+
+		EnableTrace(false);
+		return true;
+	}
+
+	bool Trace::IsRunning() const noexcept {
+		return IsTraceEnabled();
+	}
+
+	static void AppendEscaped(std::string& output, std::string_view text) {
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				output.push_back('\\');
+				output.push_back(c);
+			} else if (static_cast<unsigned char>(c) >= 0x20) {
+				output.push_back(c);
+			}
+		}
+	}
+
+	void Trace::Serialize(std::string& output, const std::vector<TraceThreadEvents>& threads) {
+		char text[128];
+		for (const TraceThreadEvents& thread : threads) {
+			auto it = std::find_if(threadStates.begin(), threadStates.end(), [&thread](const ThreadState& state) { return state.thread == thread.thread; });
+			if (it == threadStates.end()) {
+				it = threadStates.insert(threadStates.end(), ThreadState { thread.thread, 0 });
+				output.append(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":").append(std::to_string(thread.thread)).append(",\"args\":{\"name\":\"");
+				AppendEscaped(output, thread.name);
+				output.append("\"}}");
+			}
+
+			for (const TraceEvent& event : thread.events) {
+				// end events of scopes entered before Start() or before switching files have no begin events written
+				if (event.phase == 'B') {
+					it->depth++;
+				} else if (event.phase == 'E') {
+					if (it->depth == 0) {
+						continue;
+					}
+
+					it->depth--;
+				}
+
+				// events recorded before Start() are discarded, so the timestamp never goes backward
+				uint64_t timestamp = event.timestamp - std::min(event.timestamp, startTime);
+				int length = snprintf(text, sizeof(text), ",\n{\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%u", event.phase,
+					static_cast<unsigned long long>(timestamp / 1000), static_cast<unsigned int>(timestamp % 1000), thread.thread);
+				output.append(text, static_cast<size_t>(length));
+
+				// end events are matched with begin events by chrome
+				if (event.name != nullptr) {
+					output.append(",\"name\":\"");
+					AppendEscaped(output, event.name);
+					output.push_back('"');
+				}
+
+				if (event.phase == 'i') {
+					output.append(",\"s\":\"t\"");
+				}
+
+				if (event.warp != nullptr) {
+					length = snprintf(text, sizeof(text), ",\"args\":{\"warp\":\"%p\"}", event.warp);
+					output.append(text, static_cast<size_t>(length));
+				}
+
+				output.push_back('}');
+			}
+		}
+	}
+
+	Coroutine<Result<size_t>> Trace::Flush(LuaState lua, Required<RefPtr<File>> file) {
+		if (flushing) {
+			lua.deref(std::move(file.get()));
+			co_return ResultError("[ERROR] Trace::Flush() -> Another flush is in progress!");
+		}
+
+		// a reopened file is truncated, so it is smaller than what we have written to it
+		File* target = file.get().get();
+		bool retarget = !targetFile || targetFile.get() != target;
+		bool restart = retarget || target->GetSize() < targetOffset;
+		if (retarget) {
+			lua.deref(std::move(targetFile));
+			targetFile = std::move(file.get());
+		} else {
+			lua.deref(std::move(file.get()));
+		}
+
+		flushing = true;
+		Warp* currentWarp = co_await Warp::Switch(std::source_location::current(), &GetWarp());
+		std::vector<TraceThreadEvents> threads;
+		droppedCount += CollectTrace(threads);
+
+		std::string output;
+		if (restart) {
+			// the json array format allows omitting the closing bracket, so events can be appended at any time
+			targetOffset = 0;
+			threadStates.clear();
+			output.append("[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"coluster\"}}");
+		}
+
+		size_t eventCount = 0;
+		for (const TraceThreadEvents& thread : threads) {
+			eventCount += thread.events.size();
+		}
+
+		Serialize(output, threads);
+		size_t offset = targetOffset;
+		targetOffset += output.size();
+
+		auto writeResult = co_await target->Write(offset, output, nullptr);
+		co_await Warp::Switch(std::source_location::current(), currentWarp);
+		flushing = false;
+
+		if (!writeResult) {
+			co_return std::move(writeResult);
+		}
+
+		co_return std::move(eventCount);
+	}
 }
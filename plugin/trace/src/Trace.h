@@ -8,14 +8,42 @@
 #include "TraceCommon.h"
 
 namespace coluster {
+	class File;
+
+	// records IRIS_PROFILE_XXX spans of all threads and writes them as chrome trace events
+	// the output can be opened by chrome://tracing or https://ui.perfetto.dev
 	class Trace : public Object, protected Warp {
 	public:
 		Trace(AsyncWorker& asyncWorker);
 		~Trace() noexcept override;
+		Warp& GetWarp() noexcept { return *this; }
+		Warp* GetObjectWarp() const noexcept override { return const_cast<Trace*>(this); }
 
 		void lua_initialize(LuaState lua, int index);
 		void lua_finalize(LuaState lua, int index);
 		static void lua_registar(LuaState lua);
+
+		bool Start();
+		bool Stop();
+		bool IsRunning() const noexcept;
+		// append pending events to file, the trace file is restarted if another file is given or the file is reopened
+		Coroutine<Result<size_t>> Flush(LuaState lua, Required<RefPtr<File>> file);
+		uint64_t GetDroppedCount() const noexcept { return droppedCount; }
+
+	protected:
+		struct ThreadState {
+			uint32_t thread;
+			size_t depth; // count of begin events written without end events
+		};
+
+		void Serialize(std::string& output, const std::vector<TraceThreadEvents>& threads);
+
+	protected:
+		RefPtr<File> targetFile; // held until another file is given, so its address is never taken by a new file
+		size_t targetOffset = 0;
+		uint64_t startTime = 0;
+		uint64_t droppedCount = 0;
+		bool flushing = false;
+		std::vector<ThreadState> threadStates; // threads with names written to current file
 	};
 }
-
@@ -14,7 +14,7 @@ namespace coluster {
 	void DataBuffer::lua_initialize(LuaState lua, int index) noexcept {}
 
 	Coroutine<void> DataBuffer::Resize(size_t length) {
-		memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ length, 0 });
+		memoryQuotaResource = co_await asyncWorker.GetMemoryQuotaQueue().guard({ length, 0 }, MemoryCategory::DataBuffer);
 		buffer.resize(length);
 	}
 
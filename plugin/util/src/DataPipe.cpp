@@ -55,7 +55,7 @@ namespace coluster {
 
 	Coroutine<void> DataPipe::Push(std::string_view data) {
 		assert(Warp::get_current_warp() == inputWarp);
-		memoryQuotaResource.merge(co_await asyncPipe.get_async_worker().GetMemoryQuotaQueue().guard({ data.size(), 0 }));
+		memoryQuotaResource.merge(co_await asyncPipe.get_async_worker().GetMemoryQuotaQueue().guard({ data.size(), 0 }, MemoryCategory::DataPipe));
 		auto guard = in_fence();
 		dataQueueList.push(data.data(), data.data() + data.size());
 		asyncPipe.emplace(data.size());
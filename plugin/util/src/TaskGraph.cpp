@@ -0,0 +1,227 @@
+#include "TaskGraph.h"
+
+namespace coluster {
+	TaskGraph::TaskGraph(AsyncWorker& worker) : asyncWorker(worker), dispatcher(worker) {}
+	TaskGraph::~TaskGraph() noexcept {
+		assert(!running);
+	}
+
+	void TaskGraph::lua_registar(LuaState lua) {
+		lua.set_current<&TaskGraph::AddNode>("AddNode");
+		lua.set_current<&TaskGraph::AddEdge>("AddEdge");
+		lua.set_current<&TaskGraph::Clear>("Clear");
+		lua.set_current<&TaskGraph::GetNodeCount>("GetNodeCount");
+		lua.set_current<&TaskGraph::Run>("Run");
+	}
+
+	void TaskGraph::lua_initialize(LuaState lua, int index) noexcept {}
+
+	void TaskGraph::lua_finalize(LuaState lua, int index) {
+		for (auto& node : nodes) {
+			lua.deref(std::move(node.script));
+		}
+
+		nodes.clear();
+	}
+
+	size_t TaskGraph::AddNativeNode(Warp* warp, std::function<void()>&& func, std::string_view name) {
+		assert(!running);
+		Node& node = nodes.emplace_back();
+		node.warp = warp;
+		node.native = std::move(func);
+		node.name = name;
+		return nodes.size() - 1;
+	}
+
+	bool TaskGraph::AddNativeEdge(size_t from, size_t to) {
+		assert(!running);
+		if (from >= nodes.size() || to >= nodes.size() || from == to) {
+			return false;
+		}
+
+		std::vector<size_t>& nextNodes = nodes[from].nextNodes;
+		if (std::find(nextNodes.begin(), nextNodes.end(), to) == nextNodes.end()) {
+			nextNodes.emplace_back(to);
+		}
+
+		return true;
+	}
+
+	// lua nodes must not yield, they are called on the root state of the script warp
+	Result<size_t> TaskGraph::AddNode(LuaState lua, Ref&& func, std::string_view name) {
+		if (running) {
+			lua.deref(std::move(func));
+			return ResultError("[ERROR] TaskGraph::AddNode() -> Graph is running!");
+		}
+
+		Node& node = nodes.emplace_back();
+		node.warp = Warp::get_current_warp();
+		node.script = std::move(func);
+		node.name = name;
+		return nodes.size();
+	}
+
+	Result<bool> TaskGraph::AddEdge(size_t from, size_t to) {
+		if (running) {
+			return ResultError("[ERROR] TaskGraph::AddEdge() -> Graph is running!");
+		}
+
+		if (from == 0 || to == 0 || !AddNativeEdge(from - 1, to - 1)) {
+			return ResultError("[ERROR] TaskGraph::AddEdge() -> Invalid node index!");
+		}
+
+		return true;
+	}
+
+	Result<bool> TaskGraph::Clear(LuaState lua) {
+		if (running) {
+			return ResultError("[ERROR] TaskGraph::Clear() -> Graph is running!");
+		}
+
+		lua_finalize(lua, 0);
+		return true;
+	}
+
+	bool TaskGraph::IsAcyclic() const {
+		std::vector<size_t> inDegrees(nodes.size(), 0);
+		for (const auto& node : nodes) {
+			for (size_t next : node.nextNodes) {
+				inDegrees[next]++;
+			}
+		}
+
+		std::vector<size_t> stack;
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (inDegrees[i] == 0) {
+				stack.emplace_back(i);
+			}
+		}
+
+		size_t visited = 0;
+		while (!stack.empty()) {
+			size_t index = stack.back();
+			stack.pop_back();
+			visited++;
+
+			for (size_t next : nodes[index].nextNodes) {
+				if (--inDegrees[next] == 0) {
+					stack.emplace_back(next);
+				}
+			}
+		}
+
+		return visited == nodes.size();
+	}
+
+	void TaskGraph::Execute(Node& node) {
+		// skip the rest nodes once any node failed, but still release their successors
+		if (failed.load(std::memory_order_acquire)) {
+			node.timing = Timing();
+			return;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		if (node.native) {
+			node.native();
+		} else if (node.script) {
+			lua_State* L = node.warp->GetLuaRoot();
+			assert(L != nullptr);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, node.script.get_ref_index());
+			if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+				if (!failed.exchange(true, std::memory_order_acq_rel)) {
+					// error objects are not always strings, and luaL_optstring would raise outside of the pcall
+					const char* message = lua_tostring(L, -1);
+					error = message != nullptr ? message : "[ERROR] TaskGraph::Run() -> Unknown error!";
+				}
+
+				lua_pop(L, 1);
+			}
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		node.timing.start = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(start - runStart).count());
+		node.timing.duration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		node.timing.threadIndex = AsyncWorker::get_current_thread_index();
+	}
+
+	Coroutine<bool> TaskGraph::RunNative() {
+		assert(!running);
+		assert(IsAcyclic());
+		running = true;
+		failed.store(false, std::memory_order_relaxed);
+		error.clear();
+
+		if (!nodes.empty()) {
+			// routines are consumed by each run, so rebuild them from nodes
+			std::vector<Dispatcher::routine_t*> routines(nodes.size());
+			for (size_t i = 0; i < nodes.size(); i++) {
+				routines[i] = dispatcher.allocate(nodes[i].warp, [this, i]() {
+					Execute(nodes[i]);
+				});
+			}
+
+			Dispatcher::routine_t* tail = dispatcher.allocate(nullptr);
+			for (size_t i = 0; i < nodes.size(); i++) {
+				const std::vector<size_t>& nextNodes = nodes[i].nextNodes;
+				for (size_t next : nextNodes) {
+					dispatcher.order(routines[i], routines[next]);
+				}
+
+				if (nextNodes.empty()) {
+					dispatcher.order(routines[i], tail);
+				}
+			}
+
+			auto listener = iris::iris_listen_dispatch(dispatcher, tail);
+			runStart = std::chrono::steady_clock::now();
+
+			// start from the free pool, so nodes on the current warp never run inside this coroutine
+			asyncWorker.queue([this, routines = std::move(routines)]() {
+				for (Dispatcher::routine_t* routine : routines) {
+					dispatcher.dispatch(routine);
+				}
+			});
+
+			co_await listener;
+		}
+
+		running = false;
+		co_return !failed.load(std::memory_order_acquire);
+	}
+
+	Coroutine<Result<Ref>> TaskGraph::Run(LuaState lua) {
+		if (running) {
+			co_return ResultError("[ERROR] TaskGraph::Run() -> Graph is running!");
+		}
+
+		if (!IsAcyclic()) {
+			co_return ResultError("[ERROR] TaskGraph::Run() -> Graph has cycles!");
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		bool success = co_await RunNative();
+		uint64_t total = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+		if (!success) {
+			co_return ResultError(std::move(error));
+		}
+
+		co_return lua.make_table([this, total](LuaState lua) {
+			lua.set_current("Total", total);
+			lua.set_current("Nodes", lua.make_table([this](LuaState lua) {
+				for (size_t i = 0; i < nodes.size(); i++) {
+					const Node& node = nodes[i];
+					lua.set_current(i + 1, lua.make_table([&node](LuaState lua) {
+						lua.set_current("Name", std::string_view(node.name));
+						lua.set_current("Start", node.timing.start);
+						lua.set_current("Duration", node.timing.duration);
+						// threads not owned by the worker (e.g. a host thread polling without an index) have no index to report
+						if (node.timing.threadIndex != ~size_t(0)) {
+							lua.set_current("Thread", node.timing.threadIndex);
+						}
+					}));
+				}
+			}));
+		});
+	}
+}
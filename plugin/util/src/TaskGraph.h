@@ -0,0 +1,61 @@
+// TaskGraph.h
+// PaintDream (paintdream@paintdream.com)
+// 2026-10-17
+//
+
+#pragma once
+
+#include "UtilCommon.h"
+
+namespace coluster {
+	// a reusable directed-acyclic graph of nodes, dependencies are resolved by iris_dispatcher_t without resuming the script
+	// nodes added from lua run on the script warp, native nodes can be bound to any warp or the free pool (nullptr)
+	class TaskGraph : public Object {
+	public:
+		TaskGraph(AsyncWorker& asyncWorker);
+		~TaskGraph() noexcept override;
+		static void lua_registar(LuaState lua);
+		void lua_initialize(LuaState lua, int index) noexcept;
+		void lua_finalize(LuaState lua, int index);
+
+		struct Timing {
+			uint64_t start = 0; // nanoseconds since the run started
+			uint64_t duration = 0;
+			size_t threadIndex = ~size_t(0); // ~size_t(0) if not run on a thread of the worker
+		};
+
+		UTIL_API size_t AddNativeNode(Warp* warp, std::function<void()>&& func, std::string_view name);
+		UTIL_API bool AddNativeEdge(size_t from, size_t to);
+		UTIL_API Coroutine<bool> RunNative();
+		const Timing& GetNodeTiming(size_t index) const noexcept { return nodes[index].timing; }
+
+		Result<size_t> AddNode(LuaState lua, Ref&& func, std::string_view name);
+		Result<bool> AddEdge(size_t from, size_t to);
+		Result<bool> Clear(LuaState lua);
+		size_t GetNodeCount() const noexcept { return nodes.size(); }
+		Coroutine<Result<Ref>> Run(LuaState lua);
+
+	protected:
+		using Dispatcher = iris::iris_dispatcher_t<Warp>;
+
+		struct Node {
+			Warp* warp = nullptr;
+			std::function<void()> native;
+			Ref script;
+			std::string name;
+			std::vector<size_t> nextNodes;
+			Timing timing; // of the last run
+		};
+
+		void Execute(Node& node);
+		bool IsAcyclic() const;
+
+		AsyncWorker& asyncWorker;
+		Dispatcher dispatcher;
+		std::vector<Node> nodes;
+		std::chrono::steady_clock::time_point runStart;
+		std::string error; // first error of the current run, the rest nodes are skipped once set
+		std::atomic<bool> failed = false;
+		bool running = false;
+	};
+}
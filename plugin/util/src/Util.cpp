@@ -11,6 +11,7 @@ namespace coluster {
 		lua.set_current<&Util::TypeDataPipe>("TypeDataPipe");
 		lua.set_current<&Util::TypeDataBuffer>("TypeDataBuffer");
 		lua.set_current<&Util::TypeObjectDict>("TypeObjectDict");
+		lua.set_current<&Util::TypeTaskGraph>("TypeTaskGraph");
 	}
 }
 
@@ -18,6 +19,7 @@ namespace coluster {
 #include "DataPipe.h"
 #include "DataBuffer.h"
 #include "ObjectDict.h"
+#include "TaskGraph.h"
 
 namespace coluster {
 	Ref Util::TypeDataPipe(LuaState lua) {
@@ -37,5 +39,10 @@ namespace coluster {
 		type.set(lua, "__host", lua.get_context<Ref>(LuaState::context_this_t()));
 		return type;
 	}
-}
 
+	Ref Util::TypeTaskGraph(LuaState lua) {
+		Ref type = lua.make_type<TaskGraph>("TaskGraph", std::ref(asyncWorker));
+		type.set(lua, "__host", lua.get_context<Ref>(LuaState::context_this_t()));
+		return type;
+	}
+}
@@ -20,6 +20,7 @@ namespace coluster {
 		Ref TypeDataPipe(LuaState lua);
 		Ref TypeDataBuffer(LuaState lua);
 		Ref TypeObjectDict(LuaState lua);
+		Ref TypeTaskGraph(LuaState lua);
 
 	protected:
 		AsyncWorker& asyncWorker;
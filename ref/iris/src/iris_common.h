@@ -32,6 +32,7 @@ SOFTWARE.
 #include <cstdlib>
 #include <cassert>
 #include <cstdint>
+#include <cstddef>
 #include <iterator>
 #include <utility>
 #include <tuple>
@@ -372,6 +373,101 @@ namespace iris {
 		return a & (~a + 1); // the same as a & -a, but no compiler warnings.
 	}
 
+	// move-only void() callable with fixed inline storage, never allocates
+	// callables larger than storage_size are rejected at compile time
+	template <size_t storage_size = 48, size_t storage_alignment = alignof(std::max_align_t)>
+	struct iris_inline_function_t {
+		iris_inline_function_t() noexcept : invoker(nullptr), manager(nullptr) {}
+		iris_inline_function_t(std::nullptr_t) noexcept : invoker(nullptr), manager(nullptr) {}
+
+		template <typename func_t, typename = typename std::enable_if<!std::is_same<typename std::decay<func_t>::type, iris_inline_function_t>::value && !std::is_same<typename std::decay<func_t>::type, std::nullptr_t>::value>::type>
+		iris_inline_function_t(func_t&& func) noexcept(std::is_nothrow_constructible<typename std::decay<func_t>::type, func_t&&>::value) {
+			using callable_t = typename std::decay<func_t>::type;
+			static_assert(sizeof(callable_t) <= storage_size, "Callable is too large for inline storage, reduce captures or box it manually.");
+			static_assert(storage_alignment % alignof(callable_t) == 0, "Callable alignment is not supported by inline storage.");
+			static_assert(std::is_nothrow_move_constructible<callable_t>::value, "Callable must be nothrow move constructible.");
+
+			new (storage) callable_t(std::forward<func_t>(func));
+			invoker = &invoke<callable_t>;
+			manager = &manage<callable_t>;
+		}
+
+		iris_inline_function_t(iris_inline_function_t&& rhs) noexcept : invoker(rhs.invoker), manager(rhs.manager) {
+			if (manager != nullptr) {
+				manager(storage, rhs.storage);
+				rhs.invoker = nullptr;
+				rhs.manager = nullptr;
+			}
+		}
+
+		iris_inline_function_t(const iris_inline_function_t& rhs) = delete;
+		iris_inline_function_t& operator = (const iris_inline_function_t& rhs) = delete;
+
+		iris_inline_function_t& operator = (iris_inline_function_t&& rhs) noexcept {
+			if (this != &rhs) {
+				reset();
+
+				if (rhs.manager != nullptr) {
+					rhs.manager(storage, rhs.storage);
+					invoker = rhs.invoker;
+					manager = rhs.manager;
+					rhs.invoker = nullptr;
+					rhs.manager = nullptr;
+				}
+			}
+
+			return *this;
+		}
+
+		iris_inline_function_t& operator = (std::nullptr_t) noexcept {
+			reset();
+			return *this;
+		}
+
+		~iris_inline_function_t() noexcept {
+			reset();
+		}
+
+		explicit operator bool() const noexcept {
+			return invoker != nullptr;
+		}
+
+		void operator () () {
+			IRIS_ASSERT(invoker != nullptr);
+			invoker(storage);
+		}
+
+		void reset() noexcept {
+			if (manager != nullptr) {
+				manager(nullptr, storage);
+				invoker = nullptr;
+				manager = nullptr;
+			}
+		}
+
+	protected:
+		template <typename callable_t>
+		static void invoke(void* p) {
+			(*reinterpret_cast<callable_t*>(p))();
+		}
+
+		// move to target and destroy source if target is not nullptr, otherwise just destroy source
+		template <typename callable_t>
+		static void manage(void* target, void* source) noexcept {
+			callable_t* s = reinterpret_cast<callable_t*>(source);
+			if (target != nullptr) {
+				new (target) callable_t(std::move(*s));
+			}
+
+			s->~callable_t();
+		}
+
+	protected:
+		alignas(storage_alignment) unsigned char storage[storage_size];
+		void (*invoker)(void*);
+		void (*manager)(void*, void*) noexcept;
+	};
+
 	// binary find / insert / remove extension of std::vector<> like containers.
 	template <typename key_t, typename value_t>
 	struct iris_key_value_t : std::pair<key_t, value_t> {
@@ -553,6 +649,13 @@ namespace iris {
 	extern IRIS_SHARED_LIBRARY_DECORATOR void* iris_alloc_aligned(size_t size, size_t alignment);
 	extern IRIS_SHARED_LIBRARY_DECORATOR void iris_free_aligned(void* data, size_t size) noexcept;
 
+	// arena index of current thread, accessed by iris_static_instance_t<iris_arena_index_t>::get_thread_local()
+	// root allocators only hand out blocks of the same arena, e.g. set it to the NUMA node after pinning a thread
+	// so that pages first touched by that thread stay node-local
+	struct iris_arena_index_t {
+		size_t value = 0;
+	};
+
 	// global allocator that allocates memory blocks to local allocators.
 	template <size_t alloc_size, size_t total_count>
 	struct iris_root_allocator_t {
@@ -562,12 +665,23 @@ namespace iris {
 			IRIS_ASSERT(blocks.empty());
 		}
 
+		// templated to defer instantiation, so that iris_arena_index_t can be declared as a shared static instance
+		template <typename arena_index_t = iris_arena_index_t>
+		static size_t get_current_arena() noexcept {
+			return iris_static_instance_t<arena_index_t>::get_thread_local().value;
+		}
+
 		void* allocate() {
+			size_t arena = get_current_arena();
+
 			// do fast operations in critical section
 			do {
 				std::lock_guard<std::mutex> guard(lock);
 				for (size_t i = 0; i < blocks.size(); i++) {
 					block_t& block = blocks[i];
+					if (block.arena != arena)
+						continue;
+
 					for (size_t n = 0; n < bitmap_count; n++) {
 						size_t& bitmap = block.bitmap[n];
 						size_t bit = bitmap + 1;
@@ -586,6 +700,7 @@ namespace iris {
 			// real allocation, release the critical.
 			block_t block;
 			block.address = reinterpret_cast<uint8_t*>(iris_alloc_aligned(alloc_size * total_count, alloc_size));
+			block.arena = arena;
 			std::memset(block.bitmap, 0, sizeof(block.bitmap));
 			block.bitmap[0] = 1;
 
@@ -647,6 +762,7 @@ namespace iris {
 	protected:
 		struct block_t {
 			uint8_t* address;
+			size_t arena;
 			size_t bitmap[bitmap_count];
 		};
 
@@ -2463,6 +2579,7 @@ namespace iris {
 		iris_quota_t(const amount_t& amount) noexcept {
 			for (size_t i = 0; i < n; i++) {
 				quantities[i].store(amount[i], std::memory_order_relaxed);
+				debts[i].store(0, std::memory_order_relaxed);
 			}
 
 			std::atomic_thread_fence(std::memory_order_release);
@@ -2500,10 +2617,52 @@ namespace iris {
 
 		void release(const amount_t& amount) noexcept {
 			for (size_t k = 0; k < n; k++) {
-				if (amount[k] == 0)
+				quantity_t m = amount[k];
+				if (m == 0)
 					continue;
 
-				quantities[k].fetch_add(amount[k], std::memory_order_release);
+				// pay off debts of lowering first
+				std::atomic<quantity_t>& d = debts[k];
+				quantity_t expected = d.load(std::memory_order_acquire);
+				while (expected != 0) {
+					quantity_t paid = std::min(expected, m);
+					if (d.compare_exchange_weak(expected, expected - paid, std::memory_order_acq_rel)) {
+						m -= paid;
+						break;
+					}
+				}
+
+				if (m != 0) {
+					quantities[k].fetch_add(m, std::memory_order_release);
+				}
+			}
+		}
+
+		// change the total amount at runtime, the raised part is released as usual
+		void raise(const amount_t& delta) noexcept {
+			release(delta);
+		}
+
+		// take the lowered part from available quantities, the rest is taken from future releases as debts
+		void lower(const amount_t& delta) noexcept {
+			for (size_t k = 0; k < n; k++) {
+				quantity_t m = delta[k];
+				if (m == 0)
+					continue;
+
+				std::atomic<quantity_t>& q = quantities[k];
+				quantity_t expected = q.load(std::memory_order_acquire);
+				while (expected != 0) {
+					quantity_t taken = std::min(expected, m);
+					if (q.compare_exchange_weak(expected, expected - taken, std::memory_order_acq_rel)) {
+						m -= taken;
+						break;
+					}
+				}
+
+				if (m != 0) {
+					debts[k].fetch_add(m, std::memory_order_release);
+				}
 			}
 		}
 
@@ -2548,8 +2707,18 @@ namespace iris {
 			return ret;
 		}
 
+		amount_t get_debt() const noexcept {
+			amount_t ret;
+			for (size_t i = 0; i < n; i++) {
+				ret[i] = debts[i].load(std::memory_order_acquire);
+			}
+
+			return ret;
+		}
+
 	protected:
 		std::array<std::atomic<quantity_t>, n> quantities;
+		std::array<std::atomic<quantity_t>, n> debts;
 	};
 }
 
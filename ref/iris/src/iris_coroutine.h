@@ -33,6 +33,7 @@ SOFTWARE.
 
 // C++20 coroutine support
 #include <coroutine>
+#include <optional>
 
 namespace iris {
 	// standard coroutine interface settings
@@ -73,6 +74,232 @@ namespace iris {
 		};
 	}
 
+	// size-classed, thread-caching allocator for coroutine frames
+	// frames no larger than a block are carved from blocks of block_allocator_t and never returned to root allocator until exit
+	// larger frames fall back to global operator new
+	template <template <typename...> class block_allocator_t = iris_default_block_allocator_t, size_t cache_limit = 64>
+	struct iris_frame_pool_t {
+		using block_allocator = block_allocator_t<uint8_t>;
+		static constexpr size_t block_size = block_allocator::block_size;
+		static constexpr size_t min_class_size = 64;
+		static constexpr size_t class_count = iris_log2<block_size / min_class_size>::value + 1;
+		static_assert(block_size >= min_class_size, "block size is too small.");
+
+		struct node_t {
+			node_t* next;
+		};
+
+		struct stats_t {
+			uint64_t hit_count = 0; // allocations served by thread cache
+			uint64_t miss_count = 0; // allocations refilled from global pool or new blocks
+			uint64_t large_count = 0; // allocations larger than block_size
+			uint64_t live_count = 0; // frames not deallocated yet
+			uint64_t block_count = 0; // blocks allocated from block_allocator_t
+		};
+
+		struct thread_cache_t;
+		struct global_t {
+			global_t() {
+				// make sure that root allocator is destructed after us
+				block_allocator::allocator_t::get();
+				std::fill(std::begin(free_heads), std::end(free_heads), nullptr);
+				std::fill(std::begin(free_counts), std::end(free_counts), 0);
+			}
+
+			~global_t() noexcept {
+				block_allocator allocator;
+				for (size_t i = 0; i < blocks.size(); i++) {
+					allocator.deallocate(blocks[i], block_size);
+				}
+			}
+
+			std::mutex lock;
+			node_t* free_heads[class_count];
+			size_t free_counts[class_count];
+			std::vector<uint8_t*> blocks;
+			std::vector<thread_cache_t*> caches; // living thread caches, for stats
+			stats_t retired; // stats from exited threads
+			int64_t retired_alloc_count = 0;
+			int64_t retired_free_count = 0;
+		};
+
+		struct thread_cache_t {
+			thread_cache_t() {
+				std::fill(std::begin(heads), std::end(heads), nullptr);
+				std::fill(std::begin(counts), std::end(counts), 0);
+				hit_count.store(0, std::memory_order_relaxed);
+				miss_count.store(0, std::memory_order_relaxed);
+				large_count.store(0, std::memory_order_relaxed);
+				alloc_count.store(0, std::memory_order_relaxed);
+				free_count.store(0, std::memory_order_relaxed);
+
+				global_t& global = get_global();
+				std::lock_guard<std::mutex> guard(global.lock);
+				global.caches.emplace_back(this);
+			}
+
+			~thread_cache_t() noexcept {
+				global_t& global = get_global();
+				std::lock_guard<std::mutex> guard(global.lock);
+				for (size_t c = 0; c < class_count; c++) {
+					while (heads[c] != nullptr) {
+						node_t* p = heads[c];
+						heads[c] = p->next;
+						p->next = global.free_heads[c];
+						global.free_heads[c] = p;
+						global.free_counts[c]++;
+					}
+				}
+
+				global.retired.hit_count += hit_count.load(std::memory_order_relaxed);
+				global.retired.miss_count += miss_count.load(std::memory_order_relaxed);
+				global.retired.large_count += large_count.load(std::memory_order_relaxed);
+				global.retired_alloc_count += alloc_count.load(std::memory_order_relaxed);
+				global.retired_free_count += free_count.load(std::memory_order_relaxed);
+				global.caches.erase(std::find(global.caches.begin(), global.caches.end(), this));
+			}
+
+			node_t* heads[class_count];
+			size_t counts[class_count];
+
+			// single writer counters
+			std::atomic<uint64_t> hit_count;
+			std::atomic<uint64_t> miss_count;
+			std::atomic<uint64_t> large_count;
+			std::atomic<int64_t> alloc_count;
+			std::atomic<int64_t> free_count; // may be freed on other threads
+		};
+
+		static global_t& get_global() noexcept {
+			return iris_static_instance_t<global_t>::get_global();
+		}
+
+		static thread_cache_t& get_thread_cache() noexcept {
+			return iris_static_instance_t<thread_cache_t>::get_thread_local();
+		}
+
+		static void* allocate(size_t size) {
+			thread_cache_t& cache = get_thread_cache();
+			increase(cache.alloc_count);
+
+			if (size > block_size) {
+				increase(cache.large_count);
+				return ::operator new(size);
+			}
+
+			size_t c = get_class_index(size);
+			node_t* p = cache.heads[c];
+			if (p != nullptr) {
+				increase(cache.hit_count);
+			} else {
+				increase(cache.miss_count);
+				refill(cache, c);
+				p = cache.heads[c];
+			}
+
+			cache.heads[c] = p->next;
+			cache.counts[c]--;
+			return p;
+		}
+
+		static void deallocate(void* ptr, size_t size) noexcept {
+			thread_cache_t& cache = get_thread_cache();
+			increase(cache.free_count);
+
+			if (size > block_size) {
+				::operator delete(ptr);
+				return;
+			}
+
+			size_t c = get_class_index(size);
+			node_t* p = reinterpret_cast<node_t*>(ptr);
+			p->next = cache.heads[c];
+			cache.heads[c] = p;
+
+			if (++cache.counts[c] > cache_limit) {
+				// return half of cached frames to global pool
+				global_t& global = get_global();
+				std::lock_guard<std::mutex> guard(global.lock);
+				while (cache.counts[c] > cache_limit / 2) {
+					node_t* q = cache.heads[c];
+					cache.heads[c] = q->next;
+					cache.counts[c]--;
+					q->next = global.free_heads[c];
+					global.free_heads[c] = q;
+					global.free_counts[c]++;
+				}
+			}
+		}
+
+		static stats_t get_stats() {
+			global_t& global = get_global();
+			std::lock_guard<std::mutex> guard(global.lock);
+			stats_t stats = global.retired;
+			int64_t alloc_count = global.retired_alloc_count;
+			int64_t free_count = global.retired_free_count;
+
+			for (size_t i = 0; i < global.caches.size(); i++) {
+				thread_cache_t* cache = global.caches[i];
+				stats.hit_count += cache->hit_count.load(std::memory_order_relaxed);
+				stats.miss_count += cache->miss_count.load(std::memory_order_relaxed);
+				stats.large_count += cache->large_count.load(std::memory_order_relaxed);
+				alloc_count += cache->alloc_count.load(std::memory_order_relaxed);
+				free_count += cache->free_count.load(std::memory_order_relaxed);
+			}
+
+			stats.live_count = static_cast<uint64_t>(std::max(alloc_count - free_count, (int64_t)0));
+			stats.block_count = global.blocks.size();
+			return stats;
+		}
+
+	protected:
+		template <typename counter_t>
+		static void increase(std::atomic<counter_t>& counter) noexcept {
+			counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		static size_t get_class_index(size_t size) noexcept {
+			size_t c = 0;
+			for (size_t s = min_class_size; s < size; s <<= 1) {
+				c++;
+			}
+
+			return c;
+		}
+
+		// fetch frames from global pool, or carve a new block if global pool is empty
+		static void refill(thread_cache_t& cache, size_t c) {
+			global_t& global = get_global();
+			do {
+				std::lock_guard<std::mutex> guard(global.lock);
+				while (global.free_heads[c] != nullptr && cache.counts[c] < cache_limit / 2) {
+					node_t* p = global.free_heads[c];
+					global.free_heads[c] = p->next;
+					global.free_counts[c]--;
+					p->next = cache.heads[c];
+					cache.heads[c] = p;
+					cache.counts[c]++;
+				}
+			} while (false);
+
+			if (cache.heads[c] == nullptr) {
+				uint8_t* block = block_allocator().allocate(block_size);
+				size_t class_size = min_class_size << c;
+				for (size_t offset = 0; offset + class_size <= block_size; offset += class_size) {
+					node_t* p = reinterpret_cast<node_t*>(block + offset);
+					p->next = cache.heads[c];
+					cache.heads[c] = p;
+					cache.counts[c]++;
+				}
+
+				std::lock_guard<std::mutex> guard(global.lock);
+				global.blocks.emplace_back(block);
+			}
+		}
+	};
+
+	using iris_default_frame_pool_t = iris_frame_pool_t<>;
+
 	// uniform coroutine class with a return type specified
 	template <typename return_t = void>
 	struct iris_coroutine_t {
@@ -82,6 +309,15 @@ namespace iris {
 			iris_coroutine_t get_return_object() noexcept {
 				return iris_coroutine_t(std::coroutine_handle<promise_type>::from_promise(*this));
 			}
+
+			// allocate coroutine frames from frame pool
+			static void* operator new(size_t size) {
+				return iris_default_frame_pool_t::allocate(size);
+			}
+
+			static void operator delete(void* ptr, size_t size) noexcept {
+				iris_default_frame_pool_t::deallocate(ptr, size);
+			}
 		};
 
 		explicit iris_coroutine_t(std::coroutine_handle<promise_type>&& h) : handle(std::move(h)) {}
@@ -358,7 +594,8 @@ namespace iris {
 				return false;
 
 			if (source == target) {
-				return other == nullptr || source == other;
+				// a warp stacked over others still holds them, so switching to it alone must release them
+				return (other == nullptr && (source == nullptr || source->get_stack_next() == nullptr)) || source == other;
 			} else {
 				return target == nullptr && source == other;
 			}
@@ -381,6 +618,7 @@ namespace iris {
 				typename warp_t::preempt_guard_t guard(*other, 0);
 				if (guard) {
 					// success, go resume directly
+					other->record_execution();
 					handle.resume();
 					return;
 				}
@@ -414,12 +652,36 @@ namespace iris {
 				});
 			} else {
 				// dispatching under warp context
-				if (target->get_async_worker().get_current_thread_index() != ~size_t(0)) {
+				async_worker_t& async_worker = target->get_async_worker();
+				if (async_worker.get_current_thread_index() != ~size_t(0)) {
 					if (parallel_target) {
 						target->queue_routine_parallel([this, handle = std::move(handle)]() mutable {
 							handler(std::move(handle));
 						});
 					} else {
+						// fast path: target is idle, preempt it and continue inline on current thread
+						// unless it prefers another thread, see iris_warp_t::set_affinity()
+						// only taken if no other warp is held by current thread, since a held warp stays locked until the inline run returns,
+						// so switching from one warp to another is always queued, otherwise blocking work on target would stall the tasks of source
+						size_t affinity = target->get_affinity();
+						warp_t* current = warp_t::get_current_warp();
+						if ((current == nullptr || (current == target && current->get_stack_next() == nullptr)) && (affinity == ~size_t(0) || affinity == async_worker.get_current_thread_index()) && async_worker.enter_inline_switch()) {
+							inline_guard_t inline_guard(async_worker);
+							bool reentered = current == target;
+							// *this may be destroyed after resuming, the guards only refer to stack copies
+							typename warp_t::preempt_guard_t guard(*target, 0);
+							if (guard) {
+								async_worker.record_switch(true);
+								if (!reentered) {
+									target->record_execution();
+								}
+
+								handler(std::move(handle));
+								return;
+							}
+						}
+
+						async_worker.record_switch(false);
 						target->queue_routine_post([this, handle = std::move(handle)]() mutable {
 							handler(std::move(handle));
 						});
@@ -437,6 +699,16 @@ namespace iris {
 			return source;
 		}
 
+	protected:
+		struct inline_guard_t {
+			inline_guard_t(async_worker_t& worker) noexcept : async_worker(worker) {}
+			~inline_guard_t() noexcept {
+				async_worker.leave_inline_switch();
+			}
+
+			async_worker_t& async_worker;
+		};
+
 	protected:
 		warp_t* source;
 		warp_t* target;
@@ -511,6 +783,65 @@ namespace iris {
 		return iris_select_t<iterator_t>(begin, end);
 	}
 
+	// cooperative cancellation token, shared between the requester and the cancellable operation
+	// callbacks are invoked with the internal lock held, so after unsubscribe() returns the callback is guaranteed not running.
+	// callbacks must not subscribe/unsubscribe on the same token.
+	struct iris_cancel_token_t {
+		iris_cancel_token_t() noexcept : cancelled(false) {}
+		iris_cancel_token_t(const iris_cancel_token_t&) = delete;
+		iris_cancel_token_t& operator = (const iris_cancel_token_t&) = delete;
+
+		bool is_cancelled() const noexcept {
+			return cancelled.load(std::memory_order_acquire);
+		}
+
+		// returns false if already cancelled
+		bool cancel() {
+			std::lock_guard<std::mutex> guard(lock);
+			if (cancelled.exchange(true, std::memory_order_acq_rel)) {
+				return false;
+			}
+
+			for (auto& callback : callbacks) {
+				callback.second();
+			}
+
+			callbacks.clear();
+			return true;
+		}
+
+		// returns 0 (and never invokes func) if already cancelled
+		template <typename func_t>
+		size_t subscribe(func_t&& func) {
+			std::lock_guard<std::mutex> guard(lock);
+			if (cancelled.load(std::memory_order_relaxed)) {
+				return 0;
+			}
+
+			size_t id = ++next_id;
+			callbacks.emplace_back(id, std::forward<func_t>(func));
+			return id;
+		}
+
+		void unsubscribe(size_t id) {
+			if (id != 0) {
+				std::lock_guard<std::mutex> guard(lock);
+				for (size_t i = 0; i < callbacks.size(); i++) {
+					if (callbacks[i].first == id) {
+						callbacks.erase(callbacks.begin() + i);
+						break;
+					}
+				}
+			}
+		}
+
+	protected:
+		std::atomic<bool> cancelled;
+		std::mutex lock;
+		size_t next_id = 0;
+		std::vector<std::pair<size_t, std::function<void()>>> callbacks;
+	};
+
 	// basic asynchornized base class
 	template <typename warp_t, typename async_worker_t = typename warp_t::async_worker_t>
 	struct iris_sync_t {
@@ -621,6 +952,438 @@ namespace iris {
 		std::vector<info_t> handles;
 	};
 
+	// sleep in coroutine without blocking the thread, resumes on the original warp
+	// based on iris_async_worker_t::queue_timer()
+	template <typename warp_t, typename async_worker_t = typename warp_t::async_worker_t>
+	struct iris_sleep_t : iris_sync_t<warp_t, async_worker_t> {
+		template <typename duration_t>
+		iris_sleep_t(async_worker_t& worker, duration_t&& duration) : iris_sync_t<warp_t, async_worker_t>(worker), delay(std::chrono::duration_cast<std::chrono::nanoseconds>(duration)) {}
+
+		bool await_ready() const noexcept {
+			return delay.count() <= 0;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			info_t info;
+			info.handle = std::move(handle);
+
+			if constexpr (!std::is_same_v<warp_t, void>) {
+				info.warp = warp_t::get_current_warp();
+			}
+
+			iris_sync_t<warp_t, async_worker_t>::async_worker.queue_timer([this, info = std::move(info)]() mutable {
+				iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(info));
+			}, delay);
+		}
+
+		constexpr void await_resume() const noexcept {}
+
+	protected:
+		using info_t = typename iris_sync_t<warp_t, async_worker_t>::info_t;
+		std::chrono::nanoseconds delay;
+	};
+
+	// wait for an awaitable with timeout, resumes on the original warp
+	// returns std::optional<result> (or bool for void results), which is empty (false) on timeout
+	// the awaitable is not cancelled on timeout, it's still awaited in background until it completes
+	// so lvalue awaitables are referenced and must outlive their completions, rvalue ones are moved into the shared state
+	template <typename warp_t, typename awaitable_t, typename async_worker_t = typename warp_t::async_worker_t>
+	struct iris_timeout_t : iris_sync_t<warp_t, async_worker_t> {
+		using awaitable_type_t = std::remove_reference_t<awaitable_t>;
+		using value_t = decltype(std::declval<awaitable_type_t&>().await_resume());
+		using result_t = std::conditional_t<std::is_void_v<value_t>, bool, std::optional<std::decay_t<value_t>>>;
+		using holder_t = std::conditional_t<std::is_lvalue_reference_v<awaitable_t>, awaitable_type_t*, awaitable_type_t>;
+
+		template <typename duration_t>
+		iris_timeout_t(async_worker_t& worker, awaitable_t&& awaitable, duration_t&& duration) : iris_sync_t<warp_t, async_worker_t>(worker), delay(std::chrono::duration_cast<std::chrono::nanoseconds>(duration)) {
+			if constexpr (std::is_lvalue_reference_v<awaitable_t>) {
+				state = std::make_shared<state_t>(&awaitable);
+			} else {
+				state = std::make_shared<state_t>(std::move(awaitable));
+			}
+		}
+
+		constexpr bool await_ready() const noexcept {
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			state->info.handle = std::move(handle);
+
+			if constexpr (!std::is_same_v<warp_t, void>) {
+				state->info.warp = warp_t::get_current_warp();
+			}
+
+			// `this` may be destroyed once the coroutine is resumed, so keep everything needed on stack
+			std::shared_ptr<state_t> s = state;
+			async_worker_t& worker = iris_sync_t<warp_t, async_worker_t>::async_worker;
+			std::chrono::nanoseconds d = delay;
+			wait(s, worker).run();
+
+			if (s->finished.load(std::memory_order_acquire) == 0) {
+				worker.queue_timer([s = std::move(s), &worker]() mutable {
+					if (s->finished.exchange(1, std::memory_order_acq_rel) == 0) {
+						complete(std::move(s->info), worker);
+					}
+				}, d);
+			}
+		}
+
+		result_t await_resume() noexcept {
+			IRIS_ASSERT(state->finished.load(std::memory_order_acquire) != 0);
+			return std::move(state->result);
+		}
+
+	protected:
+		using info_t = typename iris_sync_t<warp_t, async_worker_t>::info_t;
+
+		struct state_t {
+			explicit state_t(holder_t&& h) : holder(std::move(h)) {
+				finished.store(0, std::memory_order_relaxed);
+			}
+
+			awaitable_type_t& get() noexcept {
+				if constexpr (std::is_lvalue_reference_v<awaitable_t>) {
+					return *holder;
+				} else {
+					return holder;
+				}
+			}
+
+			holder_t holder;
+			info_t info;
+			result_t result = result_t();
+			std::atomic<size_t> finished;
+		};
+
+		// dispatch() is not static, so forward it via a temporary dispatcher
+		struct dispatcher_t : iris_sync_t<warp_t, async_worker_t> {
+			explicit dispatcher_t(async_worker_t& worker) : iris_sync_t<warp_t, async_worker_t>(worker) {}
+			void operator () (info_t&& info) {
+				iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(info));
+			}
+		};
+
+		static void complete(info_t&& info, async_worker_t& worker) {
+			dispatcher_t dispatcher(worker);
+			dispatcher(std::move(info));
+		}
+
+		static iris_coroutine_t<void> wait(std::shared_ptr<state_t> s, async_worker_t& worker) {
+			// await by an explicit reference, some compilers copy the awaitable returned by a reference-returning call
+			awaitable_type_t& awaitable = s->get();
+			if constexpr (std::is_void_v<value_t>) {
+				co_await awaitable;
+				if (s->finished.exchange(1, std::memory_order_acq_rel) == 0) {
+					s->result = true;
+					complete(std::move(s->info), worker);
+				}
+			} else {
+				std::decay_t<value_t> value = co_await awaitable;
+				if (s->finished.exchange(1, std::memory_order_acq_rel) == 0) {
+					s->result.emplace(std::move(value));
+					complete(std::move(s->info), worker);
+				}
+			}
+		}
+
+		std::shared_ptr<state_t> state;
+		std::chrono::nanoseconds delay;
+	};
+
+	// simple wrappers for constructing sleep/timeout awaitables
+	template <typename warp_t, typename async_worker_t, typename duration_t>
+	iris_sleep_t<warp_t, async_worker_t> iris_sleep(async_worker_t& worker, duration_t&& duration) {
+		return iris_sleep_t<warp_t, async_worker_t>(worker, std::forward<duration_t>(duration));
+	}
+
+	template <typename warp_t, typename async_worker_t, typename awaitable_t, typename duration_t>
+	iris_timeout_t<warp_t, awaitable_t&&, async_worker_t> iris_timeout(async_worker_t& worker, awaitable_t&& awaitable, duration_t&& duration) {
+		return iris_timeout_t<warp_t, awaitable_t&&, async_worker_t>(worker, std::forward<awaitable_t>(awaitable), std::forward<duration_t>(duration));
+	}
+
+	// run coroutines concurrently and wait for all of them, resumes on the original warp only once
+	// returns std::tuple of results (bool for void results)
+	template <typename warp_t, typename async_worker_t, typename... coroutines_t>
+	struct iris_when_all_t : iris_sync_t<warp_t, async_worker_t> {
+		template <typename coroutine_t>
+		using value_t = std::conditional_t<std::is_void_v<typename coroutine_t::return_type_t>, bool, typename coroutine_t::return_type_t>;
+		using result_t = std::tuple<value_t<coroutines_t>...>;
+
+		iris_when_all_t(async_worker_t& worker, coroutines_t&&... c) : iris_sync_t<warp_t, async_worker_t>(worker), coroutines(std::move(c)...) {
+			// the extra one is released after all coroutines started, so no one resumes us during starting
+			remaining.store(sizeof...(coroutines_t) + 1, std::memory_order_relaxed);
+		}
+
+		constexpr bool await_ready() const noexcept {
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			info.handle = std::move(handle);
+
+			if constexpr (!std::is_same_v<warp_t, void>) {
+				info.warp = warp_t::get_current_warp();
+			}
+
+			start<0>();
+
+			// all completed synchronously? resume directly
+			return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+		}
+
+		result_t await_resume() {
+			return std::apply([](auto&&... values) {
+				return result_t(std::move(*values)...);
+			}, results);
+		}
+
+	protected:
+		using info_t = typename iris_sync_t<warp_t, async_worker_t>::info_t;
+
+		template <size_t index>
+		void start() {
+			if constexpr (index < sizeof...(coroutines_t)) {
+				auto& coroutine = std::get<index>(coroutines);
+				if constexpr (std::is_void_v<typename std::tuple_element_t<index, std::tuple<coroutines_t...>>::return_type_t>) {
+					coroutine.complete([this]() {
+						std::get<index>(results).emplace(true);
+						finish();
+					}).run();
+				} else {
+					coroutine.complete([this](auto&& value) {
+						std::get<index>(results).emplace(std::move(value));
+						finish();
+					}).run();
+				}
+
+				start<index + 1>();
+			}
+		}
+
+		void finish() {
+			// `this` may be destroyed right after the last dispatch
+			if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(info));
+			}
+		}
+
+		std::tuple<coroutines_t...> coroutines;
+		std::tuple<std::optional<value_t<coroutines_t>>...> results;
+		std::atomic<size_t> remaining;
+		info_t info;
+	};
+
+	// run coroutines of the same type concurrently and wait for the first completed one, resumes on the original warp only once
+	// returns std::pair of the index and its result (bool for void results)
+	// the rest ones are not cancelled, they keep running in background until completion
+	template <typename warp_t, typename coroutine_t, typename async_worker_t = typename warp_t::async_worker_t>
+	struct iris_when_any_t : iris_sync_t<warp_t, async_worker_t> {
+		using value_t = std::conditional_t<std::is_void_v<typename coroutine_t::return_type_t>, bool, typename coroutine_t::return_type_t>;
+		using result_t = std::pair<size_t, value_t>;
+
+		iris_when_any_t(async_worker_t& worker, std::vector<coroutine_t>&& c) : iris_sync_t<warp_t, async_worker_t>(worker), coroutines(std::move(c)), state(std::make_shared<state_t>(worker)) {
+			IRIS_ASSERT(!coroutines.empty());
+		}
+
+		constexpr bool await_ready() const noexcept {
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			state->info.handle = std::move(handle);
+
+			if constexpr (!std::is_same_v<warp_t, void>) {
+				state->info.warp = warp_t::get_current_warp();
+			}
+
+			// `this` may be destroyed once the first one completes, so keep everything needed on stack
+			std::shared_ptr<state_t> s = state;
+			std::vector<coroutine_t> c = std::move(coroutines);
+			for (size_t i = 0; i < c.size(); i++) {
+				if constexpr (std::is_void_v<typename coroutine_t::return_type_t>) {
+					c[i].complete([s, i]() {
+						if (s->finished.exchange(1, std::memory_order_acq_rel) == 0) {
+							s->result.emplace(i, true);
+							s->complete();
+						}
+					}).run();
+				} else {
+					c[i].complete([s, i](auto&& value) {
+						if (s->finished.exchange(1, std::memory_order_acq_rel) == 0) {
+							s->result.emplace(i, std::move(value));
+							s->complete();
+						}
+					}).run();
+				}
+			}
+		}
+
+		result_t await_resume() {
+			IRIS_ASSERT(state->result);
+			return std::move(state->result.value());
+		}
+
+	protected:
+		using info_t = typename iris_sync_t<warp_t, async_worker_t>::info_t;
+
+		// dispatch() is not static, so forward it via the shared state
+		struct state_t : iris_sync_t<warp_t, async_worker_t> {
+			explicit state_t(async_worker_t& worker) : iris_sync_t<warp_t, async_worker_t>(worker) {
+				finished.store(0, std::memory_order_relaxed);
+			}
+
+			void complete() {
+				iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(info));
+			}
+
+			info_t info;
+			std::optional<result_t> result;
+			std::atomic<size_t> finished;
+		};
+
+		std::vector<coroutine_t> coroutines;
+		std::shared_ptr<state_t> state;
+	};
+
+	template <typename warp_t, typename async_worker_t, typename... coroutines_t>
+	iris_when_all_t<warp_t, async_worker_t, std::decay_t<coroutines_t>...> iris_when_all(async_worker_t& worker, coroutines_t&&... coroutines) {
+		return iris_when_all_t<warp_t, async_worker_t, std::decay_t<coroutines_t>...>(worker, std::move(coroutines)...);
+	}
+
+	template <typename warp_t, typename async_worker_t, typename coroutine_t>
+	iris_when_any_t<warp_t, coroutine_t, async_worker_t> iris_when_any(async_worker_t& worker, std::vector<coroutine_t>&& coroutines) {
+		return iris_when_any_t<warp_t, coroutine_t, async_worker_t>(worker, std::move(coroutines));
+	}
+
+	template <typename warp_t, typename async_worker_t, typename coroutine_t, typename... coroutines_t>
+	iris_when_any_t<warp_t, std::decay_t<coroutine_t>, async_worker_t> iris_when_any(async_worker_t& worker, coroutine_t&& first, coroutines_t&&... rest) {
+		std::vector<std::decay_t<coroutine_t>> coroutines;
+		coroutines.reserve(sizeof...(coroutines_t) + 1);
+		coroutines.emplace_back(std::move(first));
+		(coroutines.emplace_back(std::move(rest)), ...);
+		return iris_when_any_t<warp_t, std::decay_t<coroutine_t>, async_worker_t>(worker, std::move(coroutines));
+	}
+
+	// split [begin, end) recursively into halves until no larger than grain, the right halves are queued as tasks
+	// so they can be stolen by idle threads (with work stealing enabled), while the left ones are executed in place
+	// resumes on the original warp only once after all sub-ranges completed
+	template <typename derived_t, typename warp_t, typename index_t, typename async_worker_t>
+	struct iris_parallel_base_t : iris_sync_t<warp_t, async_worker_t> {
+		iris_parallel_base_t(async_worker_t& worker, index_t b, index_t e, index_t g) : iris_sync_t<warp_t, async_worker_t>(worker), begin(b), end(std::max(b, e)), grain(std::max(g, index_t(1))) {
+			// the extra one is released after the caller finished its own part
+			remaining.store(static_cast<size_t>(end - begin) + 1, std::memory_order_relaxed);
+		}
+
+		bool await_ready() const noexcept {
+			return begin == end;
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			info.handle = std::move(handle);
+
+			if constexpr (!std::is_same_v<warp_t, void>) {
+				info.warp = warp_t::get_current_warp();
+			}
+
+			split(begin, end);
+
+			// all completed before us? resume directly
+			return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+		}
+
+	protected:
+		using info_t = typename iris_sync_t<warp_t, async_worker_t>::info_t;
+
+		void split(index_t from, index_t to) {
+			while (to - from > grain) {
+				index_t mid = from + (to - from) / 2;
+				iris_sync_t<warp_t, async_worker_t>::async_worker.queue([this, mid, to]() {
+					split(mid, to);
+				});
+
+				to = mid;
+			}
+
+			static_cast<derived_t*>(this)->execute(from, to);
+
+			// `this` may be destroyed right after the last dispatch
+			size_t count = static_cast<size_t>(to - from);
+			if (remaining.fetch_sub(count, std::memory_order_acq_rel) == count) {
+				iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(info));
+			}
+		}
+
+		index_t begin;
+		index_t end;
+		index_t grain;
+		std::atomic<size_t> remaining;
+		info_t info;
+	};
+
+	// co_await iris_parallel_for(...) calls func(sub_begin, sub_end) concurrently on sub-ranges of [begin, end)
+	// func must be thread safe and must not throw
+	template <typename warp_t, typename index_t, typename func_t, typename async_worker_t = typename warp_t::async_worker_t>
+	struct iris_parallel_for_t : iris_parallel_base_t<iris_parallel_for_t<warp_t, index_t, func_t, async_worker_t>, warp_t, index_t, async_worker_t> {
+		using base_t = iris_parallel_base_t<iris_parallel_for_t<warp_t, index_t, func_t, async_worker_t>, warp_t, index_t, async_worker_t>;
+		iris_parallel_for_t(async_worker_t& worker, index_t b, index_t e, index_t g, func_t&& f) : base_t(worker, b, e, g), func(std::move(f)) {}
+
+		void await_resume() noexcept {}
+
+	protected:
+		friend base_t;
+		void execute(index_t from, index_t to) {
+			func(from, to);
+		}
+
+		func_t func;
+	};
+
+	// co_await iris_parallel_reduce(...) maps sub-ranges of [begin, end) concurrently with map(sub_begin, sub_end) -> value_t,
+	// then folds init and the mapped values with combine(value_t&&, value_t&&) in range order on the original warp
+	// so combine only needs to be associative. map must be thread safe and must not throw
+	template <typename warp_t, typename index_t, typename value_t, typename map_t, typename combine_t, typename async_worker_t = typename warp_t::async_worker_t>
+	struct iris_parallel_reduce_t : iris_parallel_base_t<iris_parallel_reduce_t<warp_t, index_t, value_t, map_t, combine_t, async_worker_t>, warp_t, index_t, async_worker_t> {
+		using base_t = iris_parallel_base_t<iris_parallel_reduce_t<warp_t, index_t, value_t, map_t, combine_t, async_worker_t>, warp_t, index_t, async_worker_t>;
+		iris_parallel_reduce_t(async_worker_t& worker, index_t b, index_t e, index_t g, value_t&& i, map_t&& m, combine_t&& c) : base_t(worker, b, e, g), init(std::move(i)), map(std::move(m)), combine(std::move(c)) {}
+
+		value_t await_resume() {
+			std::sort(partials.begin(), partials.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+			value_t result = std::move(init);
+			for (auto& partial : partials) {
+				result = combine(std::move(result), std::move(partial.second));
+			}
+
+			partials.clear();
+			return result;
+		}
+
+	protected:
+		friend base_t;
+		void execute(index_t from, index_t to) {
+			value_t value = map(from, to);
+			std::lock_guard<std::mutex> guard(lock);
+			partials.emplace_back(from, std::move(value));
+		}
+
+		value_t init;
+		map_t map;
+		combine_t combine;
+		std::mutex lock;
+		std::vector<std::pair<index_t, value_t>> partials;
+	};
+
+	template <typename warp_t, typename async_worker_t, typename index_t, typename func_t>
+	iris_parallel_for_t<warp_t, index_t, std::decay_t<func_t>, async_worker_t> iris_parallel_for(async_worker_t& worker, index_t begin, index_t end, index_t grain, func_t&& func) {
+		return iris_parallel_for_t<warp_t, index_t, std::decay_t<func_t>, async_worker_t>(worker, begin, end, grain, std::forward<func_t>(func));
+	}
+
+	template <typename warp_t, typename async_worker_t, typename index_t, typename value_t, typename map_t, typename combine_t>
+	iris_parallel_reduce_t<warp_t, index_t, std::decay_t<value_t>, std::decay_t<map_t>, std::decay_t<combine_t>, async_worker_t> iris_parallel_reduce(async_worker_t& worker, index_t begin, index_t end, index_t grain, value_t&& init, map_t&& map, combine_t&& combine) {
+		return iris_parallel_reduce_t<warp_t, index_t, std::decay_t<value_t>, std::decay_t<map_t>, std::decay_t<combine_t>, async_worker_t>(worker, begin, end, grain, std::forward<value_t>(init), std::forward<map_t>(map), std::forward<combine_t>(combine));
+	}
+
 	// pipe-like multiple coroutine synchronization (spsc)
 	template <typename element_t, typename warp_t, typename async_worker_t = typename warp_t::async_worker_t>
 	struct iris_pipe_t : iris_sync_t<warp_t, async_worker_t>, protected enable_in_out_fence_t<size_t> {
@@ -958,18 +1721,81 @@ namespace iris {
 	}
 
 	// get quota in coroutine
+	// waiters are pushed to a lock-free list and served by a single drainer at a time (whoever requests draining first),
+	// in priority order (0 is the highest) and FIFO within the same priority.
+	// a waiter that does not fit can be bypassed by later ones for at most bypass_limit grants,
+	// after that it is starving and blocks all others (including the non-queued fast path) until it fits.
+	// waiter nodes are embedded in the awaitables and kept in per-priority lists, so serving starts from the fronts.
 	template <typename quota_t, typename warp_t, typename async_worker_t = typename warp_t::async_worker_t>
 	struct iris_quota_queue_t : iris_sync_t<warp_t, async_worker_t> {
-		iris_quota_queue_t(async_worker_t& worker, quota_t& q) : iris_sync_t<warp_t, async_worker_t>(worker), quota(q) {}
+		static constexpr size_t default_bypass_limit = 16;
 
 		using amount_t = typename quota_t::amount_t;
+		using quantity_t = typename amount_t::value_type;
+
+		// resources can be tagged to track usages per tag, see get_usage()
+		iris_quota_queue_t(async_worker_t& worker, quota_t& q, size_t priority_count = 1, size_t limit = default_bypass_limit, size_t tag_count = 1) : iris_sync_t<warp_t, async_worker_t>(worker), quota(q), bypass_limit(limit), waiters(std::max(priority_count, size_t(1))), usages(std::max(tag_count, size_t(1))) {
+			for (auto& usage : usages) {
+				for (auto& quantity : usage) {
+					quantity.store(0, std::memory_order_relaxed);
+				}
+			}
+
+			incoming.store(nullptr, std::memory_order_relaxed);
+			cancelled.store(nullptr, std::memory_order_relaxed);
+			drain_count.store(0, std::memory_order_relaxed);
+			starving_count.store(0, std::memory_order_relaxed);
+		}
+
+		// waiters live in their awaitables, so there is nothing to free here
+		~iris_quota_queue_t() noexcept {
+			IRIS_ASSERT(drain_count.load(std::memory_order_acquire) == 0);
+		}
+
 		using info_t = typename iris_sync_t<warp_t, async_worker_t>::info_t;
 
+	protected:
+		// intrusive node embedded in awaitable_t, it must not be resumed until no list refers to it
+		struct waiter_t {
+			enum : size_t {
+				state_waiting,
+				state_acquired,
+				state_cancelled
+			};
+
+			enum : size_t {
+				link_pending, // not collected yet
+				link_queued, // in the list of its priority
+				link_removed
+			};
+
+			info_t info;
+			amount_t amount;
+			size_t subscription = 0;
+			size_t priority = 0;
+			size_t ticket = 0; // arrival order, assigned by the drainer
+			size_t grant_base = 0; // grant_count when collected, so age = grant_count - grant_base. only accessed by the drainer
+			size_t link = link_pending; // only accessed by the drainer
+			std::atomic<size_t> state = state_waiting;
+			waiter_t* next = nullptr; // link of the incoming list, then of the priority list
+			waiter_t* prev = nullptr;
+			waiter_t* cancel_next = nullptr; // link of the cancelled list
+		};
+
+		struct list_t {
+			waiter_t* head = nullptr;
+			waiter_t* tail = nullptr;
+		};
+
+	public:
 		struct resource_t {
-			resource_t() noexcept : host(nullptr) {}
-			resource_t(iris_quota_queue_t& q, const amount_t& m) noexcept : host(&q), amount(m) {}
+			resource_t() noexcept : host(nullptr), tag(0) {}
+			resource_t(iris_quota_queue_t& q, const amount_t& m, size_t t = 0) noexcept : host(&q), amount(m), tag(t) {
+				host->account<true>(tag, amount);
+			}
+
 			resource_t(const resource_t&) = delete;
-			resource_t(resource_t&& rhs) noexcept : host(rhs.host), amount(rhs.amount) { rhs.host = nullptr; }
+			resource_t(resource_t&& rhs) noexcept : host(rhs.host), amount(rhs.amount), tag(rhs.tag) { rhs.host = nullptr; }
 
 			resource_t& operator = (const resource_t&) = delete;
 			resource_t& operator = (resource_t&& rhs) noexcept {
@@ -978,6 +1804,7 @@ namespace iris {
 
 					host = rhs.host;
 					amount = rhs.amount;
+					tag = rhs.tag;
 					rhs.host = nullptr;
 				}
 
@@ -990,6 +1817,7 @@ namespace iris {
 
 			void clear() noexcept {
 				if (host != nullptr) {
+					host->account<false>(tag, amount);
 					host->release(amount);
 					host = nullptr;
 				}
@@ -1000,7 +1828,11 @@ namespace iris {
 					*this = std::move(rhs);
 				} else {
 					IRIS_ASSERT(host == rhs.host);
-					acquire(rhs.amount);
+					IRIS_ASSERT(tag == rhs.tag);
+					for (size_t i = 0; i < amount.size(); i++) {
+						amount[i] += rhs.amount[i];
+					}
+
 					rhs.host = nullptr;
 				}
 			}
@@ -1011,6 +1843,8 @@ namespace iris {
 				for (size_t i = 0; i < amount.size(); i++) {
 					amount[i] += delta[i];
 				}
+
+				host->account<true>(tag, delta);
 			}
 
 			// release part of them
@@ -1021,12 +1855,17 @@ namespace iris {
 					amount[i] -= delta[i];
 				}
 
+				host->account<false>(tag, delta);
 				host->release(delta);
 			}
 
-			// move ownership of all quota
+			// move ownership of all quota, it is no longer tracked in usages
 			amount_t move() noexcept {
 				amount_t ret = get_amount();
+				if (host != nullptr) {
+					host->account<false>(tag, ret);
+				}
+
 				host = nullptr;
 				for (size_t i = 0; i < amount.size(); i++) {
 					amount[i] = 0;
@@ -1043,65 +1882,141 @@ namespace iris {
 			iris_quota_queue_t* get_queue() const noexcept {
 				return host;
 			}
+
+			// false if the wait was cancelled
+			explicit operator bool() const noexcept {
+				return host != nullptr;
+			}
 			
+			size_t get_tag() const noexcept {
+				return tag;
+			}
+
 		protected:
 			iris_quota_queue_t* host;
 			amount_t amount;
+			size_t tag;
 		};
 
 		struct awaitable_t {
-			awaitable_t(iris_quota_queue_t& q, const amount_t& m, bool r) noexcept : host(q), amount(m), ready(r) {}
+			awaitable_t(iris_quota_queue_t& q, const amount_t& m, bool r, iris_cancel_token_t* t = nullptr, size_t p = 0, size_t g = 0) noexcept : host(q), amount(m), ready(r), token(t), priority(p), tag(g) {}
+			// only movable before suspended, the waiter is not carried over
+			awaitable_t(awaitable_t&& rhs) noexcept : host(rhs.host), amount(rhs.amount), ready(rhs.ready), token(rhs.token), priority(rhs.priority), tag(rhs.tag) {
+				IRIS_ASSERT(!rhs.suspended);
+			}
 
 			bool await_ready() const noexcept {
 				return ready;
 			}
 
-			void await_suspend(std::coroutine_handle<> handle) {
-				info_t info;
-				info.handle = std::move(handle);
+			bool await_suspend(std::coroutine_handle<> handle) {
+				suspended = true;
+				waiter.info.handle = std::move(handle);
+				waiter.amount = amount;
+				waiter.priority = priority;
 
 				if constexpr (!std::is_same_v<warp_t, void>) {
-					info.warp = warp_t::get_current_warp();
+					waiter.info.warp = warp_t::get_current_warp();
+				}
+
+				// only the drainer resumes a queued waiter, it may do so at any time after the waiter is pushed,
+				// so only touch locals from there on.
+				iris_quota_queue_t* queue = &host;
+				waiter_t* w = &waiter;
+				if (token != nullptr) {
+					w->subscription = token->subscribe([queue, w]() {
+						queue->cancel_queued(w);
+					});
+
+					if (w->subscription == 0) {
+						// already cancelled, resume immediately
+						w->state.store(waiter_t::state_cancelled, std::memory_order_release);
+						return false;
+					}
 				}
 
-				host.acquire_queued(std::move(info), amount);
+				queue->acquire_queued(w);
+				return true;
 			}
 
-			resource_t await_resume() noexcept {
-				return resource_t(host, amount);
+			resource_t await_resume() {
+				if (suspended) {
+					if (waiter.state.load(std::memory_order_acquire) != waiter_t::state_acquired) {
+						return resource_t();
+					}
+
+					if (token != nullptr) {
+						token->unsubscribe(waiter.subscription);
+					}
+				}
+
+				return resource_t(host, amount, tag);
 			}
 
 		protected:
 			iris_quota_queue_t& host;
 			amount_t amount;
 			bool ready;
+			iris_cancel_token_t* token;
+			size_t priority;
+			size_t tag;
+			bool suspended = false;
+			waiter_t waiter;
 		};
 
 		awaitable_t guard(const amount_t& amount) {
-			return awaitable_t(*this, amount, quota.acquire(amount));
+			return awaitable_t(*this, amount, acquire_unqueued(amount));
+		}
+
+		// cancellable version, resumes with an empty resource_t once token is cancelled
+		awaitable_t guard(const amount_t& amount, iris_cancel_token_t* token, size_t priority = 0, size_t tag = 0) {
+			priority = std::min(priority, waiters.size() - 1);
+			IRIS_ASSERT(tag < usages.size());
+			if (token != nullptr && token->is_cancelled()) {
+				// skip acquiring, await_suspend() resumes immediately
+				return awaitable_t(*this, amount, false, token, priority, tag);
+			}
+
+			return awaitable_t(*this, amount, acquire_unqueued(amount), token, priority, tag);
 		}
 
 		bool acquire(const amount_t& amount) {
 			return quota.acquire(amount);
 		}
 
+		// acquire without queueing, fails while any waiter is starving
+		bool acquire_unqueued(const amount_t& amount) {
+			return starving_count.load(std::memory_order_acquire) == 0 && quota.acquire(amount);
+		}
+
 		void release(const amount_t& amount) {
 			quota.release(std::move(amount));
+			drain();
+		}
 
-			while (!handles.empty()) {
-				std::unique_lock<std::mutex> guard(out_lock);
+		// raise the total amount and wake up waiters that fit
+		void raise(const amount_t& delta) {
+			quota.raise(delta);
+			drain();
+		}
 
-				auto& top = handles.top();
-				if (quota.acquire(top.second)) {
-					info_t handle = std::move(top.first);
-					handles.pop();
-					guard.unlock();
+		// lower the total amount, resources already held are not affected
+		void lower(const amount_t& delta) {
+			quota.lower(delta);
+		}
 
-					iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(handle));
-				} else {
-					break;
-				}
+		// amount held by resources with given tag
+		amount_t get_usage(size_t tag) const noexcept {
+			amount_t ret;
+			for (size_t i = 0; i < ret.size(); i++) {
+				ret[i] = usages[tag][i].load(std::memory_order_acquire);
 			}
+
+			return ret;
+		}
+
+		size_t get_tag_count() const noexcept {
+			return usages.size();
 		}
 
 		amount_t get_amount() const noexcept {
@@ -1109,15 +2024,214 @@ namespace iris {
 		}
 
 	protected:
-		void acquire_queued(info_t&& info, const amount_t& amount) {
-			std::lock_guard<std::mutex> guard(in_lock);
-			handles.push(std::make_pair(std::move(info), amount));
+		template <bool add>
+		void account(size_t tag, const amount_t& delta) noexcept {
+			auto& usage = usages[tag];
+			for (size_t i = 0; i < delta.size(); i++) {
+				if (delta[i] != 0) {
+					if constexpr (add) {
+						usage[i].fetch_add(delta[i], std::memory_order_relaxed);
+					} else {
+						usage[i].fetch_sub(delta[i], std::memory_order_relaxed);
+					}
+				}
+			}
+		}
+
+		void acquire_queued(waiter_t* p) {
+			// avoid legacy compiler bugs
+			// see https://en.cppreference.com/w/cpp/atomic/atomic/compare_exchange
+			waiter_t* node = incoming.load(std::memory_order_relaxed);
+			do {
+				p->next = node;
+			} while (!incoming.compare_exchange_weak(node, p, std::memory_order_release, std::memory_order_relaxed));
+
+			// quota may be released right before we pushed, so always drain once
+			drain();
+		}
+
+		// the drainer unlinks and resumes it, see reclaim()
+		void cancel_queued(waiter_t* waiter) {
+			size_t expected = waiter_t::state_waiting;
+			if (waiter->state.compare_exchange_strong(expected, waiter_t::state_cancelled, std::memory_order_acq_rel)) {
+				waiter_t* node = cancelled.load(std::memory_order_relaxed);
+				do {
+					waiter->cancel_next = node;
+				} while (!cancelled.compare_exchange_weak(node, waiter, std::memory_order_release, std::memory_order_relaxed));
+
+				// it may be the starving one that blocks others
+				drain();
+			}
+		}
+
+		// the first requester becomes the drainer and loops until all concurrent requests are absorbed
+		void drain() {
+			if (drain_count.fetch_add(1, std::memory_order_acq_rel) != 0) {
+				return;
+			}
+
+			size_t handled = 1;
+			while (true) {
+				collect();
+				reclaim();
+				serve();
+
+				size_t count = drain_count.fetch_sub(handled, std::memory_order_acq_rel);
+				if (count == handled) {
+					break;
+				}
+
+				handled = count - handled;
+			}
+		}
+
+		void link(waiter_t* waiter) noexcept {
+			list_t& list = waiters[waiter->priority];
+			waiter->prev = list.tail;
+			waiter->next = nullptr;
+			(list.tail != nullptr ? list.tail->next : list.head) = waiter;
+			list.tail = waiter;
+			waiter->link = waiter_t::link_queued;
+		}
+
+		void unlink(waiter_t* waiter) noexcept {
+			list_t& list = waiters[waiter->priority];
+			(waiter->prev != nullptr ? waiter->prev->next : list.head) = waiter->next;
+			(waiter->next != nullptr ? waiter->next->prev : list.tail) = waiter->prev;
+			waiter->prev = waiter->next = nullptr;
+			waiter->link = waiter_t::link_removed;
+		}
+
+		// move incoming waiters to the tails of their lists in arrival order
+		void collect() {
+			waiter_t* p = incoming.exchange(nullptr, std::memory_order_acquire);
+			waiter_t* reversed = nullptr;
+			while (p != nullptr) {
+				waiter_t* q = p->next;
+				p->next = reversed;
+				reversed = p;
+				p = q;
+			}
+
+			while (reversed != nullptr) {
+				waiter_t* q = reversed->next;
+				reversed->ticket = next_ticket++;
+				reversed->grant_base = grant_count;
+				link(reversed);
+				reversed = q;
+			}
+		}
+
+		// resume cancelled waiters once they are out of the lists
+		// the ones cancelled before being collected are retried on the next pass, which their own drain() ensures
+		void reclaim() {
+			auto handle = [this](waiter_t* p) {
+				while (p != nullptr) {
+					waiter_t* q = p->cancel_next;
+					if (p->link == waiter_t::link_pending) {
+						p->cancel_next = deferred;
+						deferred = p;
+					} else {
+						if (p->link == waiter_t::link_queued) {
+							unlink(p);
+						}
+
+						iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(p->info));
+					}
+
+					p = q;
+				}
+			};
+
+			handle(std::exchange(deferred, nullptr));
+			handle(cancelled.exchange(nullptr, std::memory_order_acquire));
+		}
+
+		bool is_starving(const waiter_t* waiter) const noexcept {
+			return grant_count - waiter->grant_base >= bypass_limit;
+		}
+
+		// returns false if the quota is not enough, otherwise the waiter leaves its list
+		bool grant(waiter_t* waiter) {
+			if (!quota.acquire(waiter->amount)) {
+				return false;
+			}
+
+			unlink(waiter);
+			size_t expected = waiter_t::state_waiting;
+			if (waiter->state.compare_exchange_strong(expected, waiter_t::state_acquired, std::memory_order_acq_rel)) {
+				grant_count++;
+				iris_sync_t<warp_t, async_worker_t>::dispatch(std::move(waiter->info));
+			} else {
+				// cancelled concurrently, give it back. reclaim() resumes it
+				quota.release(waiter->amount);
+			}
+
+			return true;
+		}
+
+		// older waiters have seen more grants, so starving ones are always at the fronts of the lists
+		void serve() {
+			// starving waiters go first in arrival order, and the first one that does not fit blocks everyone
+			bool blocked = false;
+			while (true) {
+				waiter_t* first = nullptr;
+				for (auto& list : waiters) {
+					waiter_t* waiter = list.head;
+					if (waiter != nullptr && is_starving(waiter) && (first == nullptr || waiter->ticket < first->ticket)) {
+						first = waiter;
+					}
+				}
+
+				if (first == nullptr) {
+					break;
+				}
+
+				if (!grant(first)) {
+					blocked = true;
+					break;
+				}
+			}
+
+			// then bypass the ones that do not fit, until any bypassed one is about to starve
+			// at most bypass_limit waiters are skipped in a pass, so a release never walks through the whole queue
+			size_t allowance = blocked ? 0 : ~size_t(0);
+			size_t skipped = 0;
+			for (auto& list : waiters) {
+				waiter_t* waiter = list.head;
+				while (waiter != nullptr && allowance != 0 && skipped <= bypass_limit) {
+					waiter_t* next = waiter->next;
+					if (grant(waiter)) {
+						allowance = allowance == ~size_t(0) ? allowance : allowance - 1;
+					} else {
+						size_t age = grant_count - waiter->grant_base;
+						allowance = std::min(allowance, bypass_limit > age ? bypass_limit - age : size_t(0));
+						skipped++;
+					}
+
+					waiter = next;
+				}
+			}
+
+			size_t count = 0;
+			for (auto& list : waiters) {
+				count += list.head != nullptr && is_starving(list.head) ? 1 : 0;
+			}
+
+			starving_count.store(count, std::memory_order_release);
 		}
 
 	protected:
 		quota_t& quota;
-		std::mutex in_lock;
-		std::mutex out_lock;
-		iris_queue_list_t<std::pair<info_t, amount_t>> handles;
+		size_t bypass_limit;
+		size_t next_ticket = 0; // only accessed by the drainer
+		size_t grant_count = 0; // only accessed by the drainer
+		waiter_t* deferred = nullptr; // cancelled before collected, only accessed by the drainer
+		std::vector<list_t> waiters; // per priority in arrival order, only accessed by the drainer
+		std::vector<std::array<std::atomic<quantity_t>, std::tuple_size_v<amount_t>>> usages; // per tag
+		std::atomic<waiter_t*> incoming;
+		std::atomic<waiter_t*> cancelled;
+		std::atomic<size_t> drain_count;
+		std::atomic<size_t> starving_count; // priorities with a starving waiter
 	};
 }
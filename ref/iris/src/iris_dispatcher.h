@@ -35,6 +35,18 @@ SOFTWARE.
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
 
 namespace iris {
 	namespace impl {	
@@ -67,6 +79,73 @@ namespace iris {
 		};
 	}
 
+	// broadcast notifier with a sequence word (eventcount style), waiters are waked on every notify()
+	// the waiter calls prepare(), rechecks its condition, then wait_for() and finally cancel()
+	// notify() must be called after the condition is changed, it only pays a syscall if someone is waiting
+	// on linux, it's based on a private futex word, otherwise a mutex/condition_variable pair
+	struct iris_notifier_t {
+		iris_notifier_t() noexcept {
+			sequence.store(0, std::memory_order_relaxed);
+			waiting.store(0, std::memory_order_relaxed);
+		}
+
+		iris_notifier_t(const iris_notifier_t&) = delete;
+		iris_notifier_t& operator = (const iris_notifier_t&) = delete;
+
+		// returns the sequence to wait on
+		uint32_t prepare() noexcept {
+			waiting.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return sequence.load(std::memory_order_acquire);
+		}
+
+		void cancel() noexcept {
+			waiting.fetch_sub(1, std::memory_order_release);
+		}
+
+		// may return earlier (spurious wakeup)
+		template <typename duration_t>
+		void wait_for(uint32_t seq, duration_t&& delay) {
+			if (sequence.load(std::memory_order_acquire) == seq) {
+#if defined(__linux__)
+				int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+				timespec timeout;
+				timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+				timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence), FUTEX_WAIT_PRIVATE, seq, &timeout, nullptr, 0);
+#else
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait_for(lock, std::forward<duration_t>(delay), [this, seq]() { return sequence.load(std::memory_order_acquire) != seq; });
+#endif
+			}
+		}
+
+		// returns true if there were waiters
+		bool notify() {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiting.load(std::memory_order_relaxed) != 0) {
+				sequence.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+				std::lock_guard<std::mutex> lock(mutex);
+				condition.notify_all();
+#endif
+				return true;
+			} else {
+				return false;
+			}
+		}
+
+	protected:
+		std::atomic<uint32_t> sequence;
+		std::atomic<uint32_t> waiting;
+#if !defined(__linux__)
+		std::mutex mutex;
+		std::condition_variable condition;
+#endif
+	};
+
 	// dispatch routines:
 	//     1. from warp to warp. (queue_routine/queue_routine_post).
 	//     2. from external thread to warp (queue_routine_external).
@@ -102,6 +181,10 @@ namespace iris {
 						preempted = false;
 					} else {
 						preempted = warp.preempt();
+						if (!preempted) {
+							warp.async_worker.record_preempt_failure();
+						}
+
 						// recheck after preempted
 						state = preempted && (warp.suspend_count.load(std::memory_order_relaxed) <= suspend_level);
 					}
@@ -261,16 +344,30 @@ namespace iris {
 		}
 
 		// initialize with specified priority, all tasks that runs on this warp will be scheduled with this priority
-		explicit iris_warp_t(async_worker_t& worker, size_t prior = 0) : async_worker(worker), priority(prior), stack_next_warp(nullptr), parallel_task_resurrect_head(nullptr) {
+		explicit iris_warp_t(async_worker_t& worker, size_t prior = 0) : async_worker(worker), parallel_task_resurrect_head(nullptr), priority(prior), stack_next_warp(nullptr), last_thread_index(~size_t(0)) {
 			init_storage<strand>(worker.get_thread_count());
 
+			affinity.store(~size_t(0), std::memory_order_relaxed);
+			execute_count.store(0, std::memory_order_relaxed);
+			migration_count.store(0, std::memory_order_relaxed);
+			affinity_hit_count.store(0, std::memory_order_relaxed);
+			routine_count.store(0, std::memory_order_relaxed);
+			run_sample_count.store(0, std::memory_order_relaxed);
+			run_time.store(0, std::memory_order_relaxed);
 			thread_warp.store(nullptr, std::memory_order_relaxed);
 			parallel_task_head.store(nullptr, std::memory_order_relaxed);
 			suspend_count.store(0, std::memory_order_relaxed);
 			queueing.store(queue_state_t::idle, std::memory_order_release);
 		}
 
-		iris_warp_t(iris_warp_t&& rhs) noexcept : async_worker(rhs.async_worker), storage(std::move(rhs.storage)), priority(rhs.priority), stack_next_warp(rhs.stack_next_warp), parallel_task_resurrect_head(rhs.parallel_task_resurrect_head) {
+		iris_warp_t(iris_warp_t&& rhs) noexcept : async_worker(rhs.async_worker), parallel_task_resurrect_head(rhs.parallel_task_resurrect_head), storage(std::move(rhs.storage)), priority(rhs.priority), stack_next_warp(rhs.stack_next_warp), last_thread_index(rhs.last_thread_index) {
+			affinity.store(rhs.affinity.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			execute_count.store(rhs.execute_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			migration_count.store(rhs.migration_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			affinity_hit_count.store(rhs.affinity_hit_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			routine_count.store(rhs.routine_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			run_sample_count.store(rhs.run_sample_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			run_time.store(rhs.run_time.load(std::memory_order_relaxed), std::memory_order_relaxed);
 			thread_warp.store(rhs.thread_warp.load(std::memory_order_relaxed), std::memory_order_relaxed);
 			parallel_task_head.store(rhs.parallel_task_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
 			suspend_count.store(rhs.suspend_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
@@ -293,6 +390,71 @@ namespace iris {
 			IRIS_ASSERT(!has_parallel_task());
 		}
 
+		// counters of scheduled executions, see set_affinity()
+		struct affinity_stats_t {
+			uint64_t execute_count = 0; // scheduled executions
+			uint64_t migration_count = 0; // executions on a different thread from the previous one
+			uint64_t affinity_hit_count = 0; // executions on the preferred thread
+		};
+
+		// soft bind this warp to given thread, scheduled executions are routed to the inbox of that thread first
+		// the thread is only a hint, other threads can still steal the execution while it's busy
+		// pass ~size_t(0) to remove the binding
+		void set_affinity(size_t thread_index) noexcept {
+			affinity.store(thread_index, std::memory_order_relaxed);
+		}
+
+		size_t get_affinity() const noexcept {
+			return affinity.load(std::memory_order_relaxed);
+		}
+
+		affinity_stats_t get_affinity_stats() const noexcept {
+			affinity_stats_t stats;
+			stats.execute_count = execute_count.load(std::memory_order_relaxed);
+			stats.migration_count = migration_count.load(std::memory_order_relaxed);
+			stats.affinity_hit_count = affinity_hit_count.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		// counters of running routines, time in nanoseconds
+		// average run length can be derived from routine_count / execute_count and run_time / execute_count
+		// failed preemptions are counted per thread, see thread_stats_t
+		struct run_stats_t {
+			uint64_t execute_count = 0; // scheduled executions
+			uint64_t routine_count = 0; // routines run, including the ones run in place by queue_routine()
+			uint64_t run_time = 0; // time spent in scheduled executions, estimated from the timed ones
+		};
+
+		// only one of every run_time_sample_interval executions is timed to keep clock reads off the hot path
+		static constexpr uint64_t run_time_sample_interval = 16;
+
+		run_stats_t get_run_stats() const noexcept {
+			run_stats_t stats;
+			stats.execute_count = execute_count.load(std::memory_order_relaxed);
+			stats.routine_count = routine_count.load(std::memory_order_relaxed);
+			uint64_t sample_count = run_sample_count.load(std::memory_order_relaxed);
+			if (sample_count != 0) {
+				stats.run_time = static_cast<uint64_t>(static_cast<double>(run_time.load(std::memory_order_relaxed)) * static_cast<double>(stats.execute_count) / static_cast<double>(sample_count));
+			}
+
+			return stats;
+		}
+
+		// update execution counters, must be called with warp acquired so the counters have single writer
+		void record_execution() noexcept {
+			size_t thread_index = async_worker.get_current_thread_index();
+			execute_count.store(execute_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			if (last_thread_index != ~size_t(0) && thread_index != last_thread_index) {
+				migration_count.store(migration_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			if (thread_index != ~size_t(0) && thread_index == affinity.load(std::memory_order_relaxed)) {
+				affinity_hit_count.store(affinity_hit_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			last_thread_index = thread_index;
+		}
+
 		// get stack warp pointer
 		iris_warp_t* get_stack_next() const noexcept {
 			return stack_next_warp;
@@ -329,6 +491,7 @@ namespace iris {
 					flush();
 				}
 
+				yield_notifier.notify();
 				return true;
 			} else {
 				IRIS_ASSERT(get_current_warp_internal() == nullptr || exp == nullptr || *exp == nullptr);
@@ -336,6 +499,18 @@ namespace iris {
 			}
 		}
 
+		// block until this warp is yielded or resumed by others, or the timeout expired
+		// returns immediately if it's not running now, so it can be used as the waiter of join()
+		template <typename duration_t>
+		void wait_yield(duration_t&& timeout) {
+			uint32_t seq = yield_notifier.prepare();
+			if (running()) {
+				yield_notifier.wait_for(seq, std::forward<duration_t>(timeout));
+			}
+
+			yield_notifier.cancel();
+		}
+
 		// blocks all tasks preemptions, stacked with internally counting.
 		bool suspend() noexcept {
 			return suspend_count.fetch_add(1, std::memory_order_acquire) == 0;
@@ -353,6 +528,7 @@ namespace iris {
 				}
 			}
 
+			yield_notifier.notify();
 			return ret;
 		}
 
@@ -366,6 +542,7 @@ namespace iris {
 			// try to acquire execution, if it fails, just go posting
 			preempt_guard_t preempt_guard(*this, 0);
 			if (preempt_guard) {
+				record_routine();
 				func();
 			} else {
 				// send to current thread slot of current warp.
@@ -380,6 +557,13 @@ namespace iris {
 			push<strand>(std::forward<callable_t>(func));
 		}
 
+		// send a batch of tasks to this warp, always post them to queue.
+		// callables in [begin, end) are moved, and only one flush request is issued for the whole batch
+		template <typename iterator_t>
+		void queue_routine_batch(iterator_t begin, iterator_t end) {
+			push_batch<strand>(begin, end);
+		}
+
 		// queue external routine from non-warp/yielded warp
 		template <typename callable_t>
 		void queue_routine_external(callable_t&& func) {
@@ -472,6 +656,11 @@ namespace iris {
 		}
 
 	protected:
+		// must be called with warp acquired, before the routine runs, since the routine may yield the warp
+		void record_routine() noexcept {
+			routine_count.store(routine_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
 		bool has_parallel_task() const noexcept {
 			return parallel_task_head.load(std::memory_order_acquire) != nullptr || parallel_task_resurrect_head != nullptr;
 		}
@@ -578,6 +767,7 @@ namespace iris {
 				while (p != nullptr) {
 					storage.executing_head = p->next; // mark next for exception safety
 					p->next = nullptr;
+					record_routine();
 					async_worker.execute_task(p);
 					execute_counter++;
 
@@ -619,6 +809,7 @@ namespace iris {
 						typename queue_buffer_t::element_t func = std::move(buffer.top());
 						buffer.pop(); // pop up before calling
 
+						record_routine();
 						func(); // may throws exceptions
 						execute_counter++;
 						counter = next_version;
@@ -647,10 +838,20 @@ namespace iris {
 				// and it's ok to return immediately.
 				preempt_guard_t preempt_guard(*this, 0);
 				if (preempt_guard) {
+					record_execution();
 					execute_parallel();
 
 					if (!is_suspended()) { // double check for suspend_count
-						execute_internal<s, force>();
+						// execute_count was just increased by record_execution() with warp acquired, the first execution is always timed
+						if (execute_count.load(std::memory_order_relaxed) % run_time_sample_interval == 1) {
+							auto start = std::chrono::steady_clock::now();
+							execute_internal<s, force>();
+							// the execution may be taken by others after a routine yielded it, so do not use single writer counting
+							run_time.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+							run_sample_count.fetch_add(1, std::memory_order_relaxed);
+						} else {
+							execute_internal<s, force>();
+						}
 						
 						preempt_guard.cleanup();
 						if (!yield()) {
@@ -697,7 +898,12 @@ namespace iris {
 			// so we just need to queue a flush routine as soon as current state is idle
 			if (queueing.load(std::memory_order_acquire) != queue_state_t::pending) {
 				if (queueing.exchange(queue_state_t::pending, std::memory_order_acq_rel) == queue_state_t::idle) {
-					async_worker.queue(execute_t(*this), priority);
+					size_t thread_index = affinity.load(std::memory_order_relaxed);
+					if (thread_index != ~size_t(0)) {
+						async_worker.queue_affinity(execute_t(*this), thread_index, priority);
+					} else {
+						async_worker.queue(execute_t(*this), priority);
+					}
 				}
 			}
 		}
@@ -737,9 +943,60 @@ namespace iris {
 			}
 		}
 
+		template <bool s, typename iterator_t>
+		typename std::enable_if<s>::type push_batch(iterator_t begin, iterator_t end) {
+			if (begin == end) {
+				return;
+			}
+
+			// newest task at head, the same as pushing one by one
+			task_t* tail = async_worker.new_task(std::move(*begin++));
+			task_t* head = tail;
+			while (begin != end) {
+				task_t* task = async_worker.new_task(std::move(*begin++));
+				task->next = head;
+				head = task;
+			}
+
+			// avoid legacy compiler bugs
+			// see https://en.cppreference.com/w/cpp/atomic/atomic/compare_exchange
+			task_t* node = storage.queueing_head.load(std::memory_order_relaxed);
+			do {
+				tail->next = node;
+			} while (!storage.queueing_head.compare_exchange_weak(node, head, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+			flush();
+		}
+
+		template <bool s, typename iterator_t>
+		typename std::enable_if<!s>::type push_batch(iterator_t begin, iterator_t end) {
+			if (begin == end) {
+				return;
+			}
+
+			size_t thread_index = async_worker.get_current_thread_index();
+			if (thread_index != ~size_t(0)) {
+				std::vector<queue_buffer_t>& queue_buffers = storage.queue_buffers;
+				IRIS_ASSERT(thread_index < queue_buffers.size());
+				queue_buffer_t& buffer = queue_buffers[thread_index];
+				while (begin != end) {
+					buffer.push(std::move(*begin++));
+				}
+
+				flush();
+			} else {
+				IRIS_ASSERT(async_worker.is_terminated());
+				IRIS_ASSERT(!storage.queue_buffers.empty());
+				while (begin != end) {
+					storage.queue_buffers[0].push(std::move(*begin++));
+				}
+			}
+		}
+
 	protected:
 		async_worker_t& async_worker; // host async worker
 		std::atomic<iris_warp_t**> thread_warp; // save the running thread warp address.
+		iris_notifier_t yield_notifier; // waked on yield() and resume(), see wait_yield()
 		std::atomic<size_t> suspend_count; // current suspend count
 		std::atomic<queue_state_t> queueing; // is flush request sent to async_worker? 0 : not yet, 1 : yes, 2 : is to flush right away.
 		std::atomic<task_t*> parallel_task_head; // linked-list for pending parallel tasks
@@ -747,6 +1004,14 @@ namespace iris {
 		typename std::conditional<strand, chain_storage_t, grid_storage_t>::type storage; // task storage
 		size_t priority;
 		iris_warp_t* stack_next_warp;
+		size_t last_thread_index; // thread of last scheduled execution
+		std::atomic<size_t> affinity; // preferred thread index
+		std::atomic<uint64_t> execute_count;
+		std::atomic<uint64_t> migration_count;
+		std::atomic<uint64_t> affinity_hit_count;
+		std::atomic<uint64_t> routine_count;
+		std::atomic<uint64_t> run_sample_count; // timed executions
+		std::atomic<uint64_t> run_time; // sum of timed executions
 	};
 
 	// dispatcher based-on directed-acyclic graph
@@ -919,7 +1184,7 @@ namespace iris {
 	protected:
 		// after finshing a routine, unlock the next_routines
 		struct routine_guard_t {
-			routine_guard_t(iris_dispatcher_t& d, routine_t* r, std::atomic<routine_t*>* resurrect) noexcept : dispatcher(d), routine(r), resurrect_routines(resurrect) {}
+			routine_guard_t(iris_dispatcher_t& d, routine_t* r, std::atomic<routine_t*>* resurrect) noexcept : dispatcher(d), resurrect_routines(resurrect), routine(r) {}
 			~routine_guard_t() noexcept {
 				if (resurrect_routines != nullptr) {
 					// some exception throws, relink to surrect linked-list
@@ -1002,6 +1267,377 @@ namespace iris {
 		std::function<void(iris_dispatcher_t&, bool)> completion;
 	};
 
+	// cpu relax hint for spinning
+	inline void iris_cpu_pause() noexcept {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+		_mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	// single waiter parking slot (eventcount style)
+	// the waiter announces itself by prepare(), rechecks its condition and then calls wait()/wait_for()
+	// wakers only pay a syscall if the waiter has really announced
+	// on linux, it's based on a private futex word, otherwise a mutex/condition_variable pair per slot
+	struct alignas(64) iris_parker_t {
+		iris_parker_t() noexcept {
+			state.store(0, std::memory_order_relaxed);
+		}
+
+		iris_parker_t(const iris_parker_t&) = delete;
+		iris_parker_t& operator = (const iris_parker_t&) = delete;
+
+		// called by waiter before rechecking its condition
+		void prepare() noexcept {
+			state.store(1, std::memory_order_seq_cst);
+		}
+
+		// called by waiter after waked up or the condition satisfied, returns false if it's unparked by others
+		bool cancel() noexcept {
+			uint32_t expected = 1;
+			return state.compare_exchange_strong(expected, 0, std::memory_order_acq_rel, std::memory_order_relaxed);
+		}
+
+		bool is_parked() const noexcept {
+			return state.load(std::memory_order_acquire) != 0;
+		}
+
+		void wait() {
+			while (state.load(std::memory_order_acquire) != 0) {
+#if defined(__linux__)
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAIT_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return state.load(std::memory_order_acquire) == 0; });
+#endif
+			}
+		}
+
+		// may return earlier (spurious wakeup)
+		template <typename duration_t>
+		void wait_for(duration_t&& delay) {
+			if (state.load(std::memory_order_acquire) != 0) {
+#if defined(__linux__)
+				int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+				timespec timeout;
+				timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+				timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAIT_PRIVATE, 1, &timeout, nullptr, 0);
+#else
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait_for(lock, std::forward<duration_t>(delay), [this]() { return state.load(std::memory_order_acquire) == 0; });
+#endif
+			}
+		}
+
+		// returns true if the waiter is parked (or about to park) and unparked by us
+		bool unpark() {
+			uint32_t expected = 1;
+			if (state.compare_exchange_strong(expected, 0, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+#if defined(__linux__)
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+				std::lock_guard<std::mutex> lock(mutex);
+				condition.notify_one();
+#endif
+				return true;
+			} else {
+				return false;
+			}
+		}
+
+	protected:
+		std::atomic<uint32_t> state;
+#if !defined(__linux__)
+		std::mutex mutex;
+		std::condition_variable condition;
+#endif
+	};
+
+	// chase-lev work stealing deque
+	// push() and pop() must be called from the owner thread, steal() can be called from any thread
+	// see "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al. 2013
+	template <typename element_t, size_t init_capacity = 32>
+	struct iris_steal_deque_t {
+		static_assert((init_capacity & (init_capacity - 1)) == 0, "init_capacity must be power of 2.");
+
+		iris_steal_deque_t() {
+			buffers.emplace_back(std::unique_ptr<buffer_t>(new buffer_t(init_capacity)));
+			buffer.store(buffers.back().get(), std::memory_order_relaxed);
+			top.store(0, std::memory_order_relaxed);
+			bottom.store(0, std::memory_order_release);
+		}
+
+		iris_steal_deque_t(const iris_steal_deque_t&) = delete;
+		iris_steal_deque_t& operator = (const iris_steal_deque_t&) = delete;
+
+		void push(element_t* element) {
+			ptrdiff_t b = bottom.load(std::memory_order_relaxed);
+			ptrdiff_t t = top.load(std::memory_order_acquire);
+			buffer_t* array = buffer.load(std::memory_order_relaxed);
+
+			if (b - t > static_cast<ptrdiff_t>(array->mask)) {
+				array = grow(array, t, b);
+			}
+
+			array->at(b).store(element, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		element_t* pop() noexcept {
+			ptrdiff_t b = bottom.load(std::memory_order_relaxed) - 1;
+			buffer_t* array = buffer.load(std::memory_order_relaxed);
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			ptrdiff_t t = top.load(std::memory_order_relaxed);
+
+			if (t <= b) {
+				element_t* element = array->at(b).load(std::memory_order_relaxed);
+				if (t == b) {
+					// the last one, race with stealers
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						element = nullptr;
+					}
+
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+
+				return element;
+			} else {
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+		}
+
+		// returns nullptr if empty or lost the race
+		element_t* steal() noexcept {
+			ptrdiff_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			ptrdiff_t b = bottom.load(std::memory_order_acquire);
+
+			if (t < b) {
+				buffer_t* array = buffer.load(std::memory_order_acquire);
+				element_t* element = array->at(t).load(std::memory_order_relaxed);
+				if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					return element;
+				}
+			}
+
+			return nullptr;
+		}
+
+		bool empty() const noexcept {
+			return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+		}
+
+	protected:
+		struct buffer_t {
+			explicit buffer_t(size_t capacity) : mask(capacity - 1), elements(new std::atomic<element_t*>[capacity]) {}
+
+			std::atomic<element_t*>& at(ptrdiff_t index) noexcept {
+				return elements[static_cast<size_t>(index) & mask];
+			}
+
+			size_t mask;
+			std::unique_ptr<std::atomic<element_t*>[]> elements;
+		};
+
+		buffer_t* grow(buffer_t* array, ptrdiff_t t, ptrdiff_t b) {
+			// old buffers are kept alive since stealers may still read from them
+			buffers.emplace_back(std::unique_ptr<buffer_t>(new buffer_t((array->mask + 1) * 2)));
+			buffer_t* next = buffers.back().get();
+			for (ptrdiff_t i = t; i < b; i++) {
+				next->at(i).store(array->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+
+			buffer.store(next, std::memory_order_release);
+			return next;
+		}
+
+	protected:
+		alignas(64) std::atomic<ptrdiff_t> top;
+		alignas(64) std::atomic<ptrdiff_t> bottom;
+		std::atomic<buffer_t*> buffer;
+		std::vector<std::unique_ptr<buffer_t>> buffers; // owner only
+	};
+
+	// hierarchical timing wheel, not thread safe
+	// level 0 has 256 slots of one tick, each upper level has 64 slots covering a full turn of its lower level
+	// timers are cascaded to lower levels as time goes on, see "Hashed and Hierarchical Timing Wheels", Varghese et al. 1987
+	template <typename element_t, size_t level_count = 4>
+	struct iris_timer_wheel_t {
+		static_assert(level_count >= 2, "at least two levels required.");
+		static constexpr size_t root_bits = 8;
+		static constexpr size_t level_bits = 6;
+		static constexpr size_t root_size = size_t(1) << root_bits;
+		static constexpr size_t level_size = size_t(1) << level_bits;
+
+		explicit iris_timer_wheel_t(uint64_t tick = 0) noexcept : current_tick(tick), timer_count(0) {
+			for (size_t n = 0; n < level_count; n++) {
+				level_counts[n] = 0;
+			}
+		}
+
+		uint64_t get_current_tick() const noexcept {
+			return current_tick;
+		}
+
+		size_t size() const noexcept {
+			return timer_count;
+		}
+
+		// add element expiring at given absolute tick, expired ticks are delayed to the next one
+		void push(uint64_t tick, element_t&& element) {
+			place(timer_t { std::max(tick, current_tick + 1), std::move(element) });
+			timer_count++;
+		}
+
+		// move current tick forward and call func(element_t&&) for each expired element
+		template <typename func_t>
+		void advance(uint64_t tick, func_t&& func) {
+			if (timer_count == 0) {
+				current_tick = std::max(current_tick, tick);
+				return;
+			}
+
+			while (current_tick < tick) {
+				// skip empty ticks till the next boundary of the lowest non-empty level
+				uint64_t boundary = get_next_boundary();
+				if (boundary != current_tick + 1) {
+					if (boundary > tick) {
+						current_tick = tick;
+						break;
+					}
+
+					current_tick = boundary - 1;
+				}
+
+				current_tick++;
+
+				// cascade upper levels at boundaries, from top to bottom
+				for (size_t n = level_count - 1; n != 0; n--) {
+					size_t shift = get_shift(n);
+					if ((current_tick & ((uint64_t(1) << shift) - 1)) == 0) {
+						std::vector<timer_t> timers = std::move(slots[get_slot(n, current_tick >> shift)]);
+						level_counts[n] -= timers.size();
+						for (auto&& timer : timers) {
+							place(std::move(timer));
+						}
+					}
+				}
+
+				std::vector<timer_t>& slot = slots[get_slot(0, current_tick)];
+				if (!slot.empty()) {
+					std::vector<timer_t> timers = std::move(slot);
+					timer_count -= timers.size();
+					level_counts[0] -= timers.size();
+					for (auto&& timer : timers) {
+						func(std::move(timer.element));
+					}
+
+					if (timer_count == 0) {
+						current_tick = tick;
+						break;
+					}
+				}
+			}
+		}
+
+		// get the tick that advance() should reach next, it's not later than the earliest expiration
+		uint64_t get_next_tick() const noexcept {
+			if (timer_count == 0) {
+				return ~uint64_t(0);
+			} else if (level_counts[0] == 0) {
+				return get_next_boundary();
+			}
+
+			for (uint64_t tick = current_tick + 1; tick <= current_tick + root_size; tick++) {
+				if ((tick & (root_size - 1)) == 0) {
+					return tick; // cascading
+				} else if (!slots[get_slot(0, tick)].empty()) {
+					return tick;
+				}
+			}
+
+			return current_tick + root_size;
+		}
+
+		// remove all elements regardless of their expiration
+		template <typename func_t>
+		void clear(func_t&& func) {
+			for (auto&& slot : slots) {
+				std::vector<timer_t> timers = std::move(slot);
+				for (auto&& timer : timers) {
+					func(std::move(timer.element));
+				}
+			}
+
+			timer_count = 0;
+			for (size_t n = 0; n < level_count; n++) {
+				level_counts[n] = 0;
+			}
+		}
+
+	protected:
+		struct timer_t {
+			uint64_t tick;
+			element_t element;
+		};
+
+		static constexpr size_t get_shift(size_t level) noexcept {
+			return level == 0 ? 0 : root_bits + (level - 1) * level_bits;
+		}
+
+		static size_t get_slot(size_t level, uint64_t index) noexcept {
+			return level == 0 ? static_cast<size_t>(index & (root_size - 1)) : root_size + (level - 1) * level_size + static_cast<size_t>(index & (level_size - 1));
+		}
+
+		// the next tick that needs attention: current_tick + 1 if root level is not empty
+		// otherwise the next cascading boundary of the lowest non-empty level
+		uint64_t get_next_boundary() const noexcept {
+			for (size_t n = 0; n < level_count; n++) {
+				if (level_counts[n] != 0) {
+					return n == 0 ? current_tick + 1 : (current_tick | ((uint64_t(1) << get_shift(n)) - 1)) + 1;
+				}
+			}
+
+			return ~uint64_t(0);
+		}
+
+		void place(timer_t&& timer) {
+			IRIS_ASSERT(timer.tick >= current_tick);
+			if (timer.tick - current_tick < root_size) {
+				slots[get_slot(0, timer.tick)].emplace_back(std::move(timer));
+				level_counts[0]++;
+				return;
+			}
+
+			// never place into the current slot of upper levels, it will not be cascaded until next turn
+			for (size_t n = 1; n < level_count; n++) {
+				size_t shift = get_shift(n);
+				if ((timer.tick >> shift) - (current_tick >> shift) < level_size) {
+					slots[get_slot(n, timer.tick >> shift)].emplace_back(std::move(timer));
+					level_counts[n]++;
+					return;
+				}
+			}
+
+			// out of range, park it at the last slot of top level and replace it on cascading
+			size_t shift = get_shift(level_count - 1);
+			slots[get_slot(level_count - 1, (current_tick >> shift) + level_size - 1)].emplace_back(std::move(timer));
+			level_counts[level_count - 1]++;
+		}
+
+		uint64_t current_tick;
+		size_t timer_count;
+		size_t level_counts[level_count];
+		std::vector<timer_t> slots[root_size + (level_count - 1) * level_size];
+	};
+
 	// here we code a trivial worker demo
 	// could be replaced by your implementation
 	template <typename thread_t = std::thread, typename callback_t = std::function<void()>, template <typename...> class allocator_t = iris_default_object_allocator_t, size_t default_task_duplicate_count = 4, size_t default_sub_allocator_count = 4>
@@ -1037,11 +1673,118 @@ namespace iris {
 		template <typename element_t>
 		using general_allocator_t = allocator_t<element_t>;
 		using task_allocator_t = allocator_t<task_t>;
+		using task_deque_t = iris_steal_deque_t<task_t>;
+
+		// idle policy for internal threads: spin with pause, then yield, then park
+		// spin budget doubles on spin hit and halves on spin miss within [spin_min, spin_max]
+		// set spin_max to 0 to park immediately (the default)
+		struct idle_policy_t {
+			size_t spin_min = 0;
+			size_t spin_max = 0;
+			size_t yield_count = 0;
+		};
+
+		// idle counters, time in nanoseconds
+		struct idle_stats_t {
+			uint64_t spin_hit_count = 0;
+			uint64_t spin_miss_count = 0;
+			uint64_t spin_time = 0;
+			uint64_t park_count = 0;
+			uint64_t park_time = 0;
+		};
+
+		// switch counters, see iris_switch_t
+		struct switch_stats_t {
+			uint64_t inline_count = 0;
+			uint64_t queued_count = 0;
+		};
+
+		// scheduler counters of one thread, time in nanoseconds
+		// only tasks polled and queued by threads of this worker are counted
+		struct thread_stats_t {
+			std::vector<uint64_t> execute_counts; // tasks executed, indexed by priority
+			uint64_t depth_peak = 0; // high-water mark of outstanding tasks of all priorities (queued or running) seen on queueing
+			uint64_t steal_count = 0; // tasks taken from deques or inboxes of other threads
+			uint64_t cas_retry_count = 0; // failed compare-exchanges on publishing tasks
+			uint64_t preempt_failure_count = 0; // failed attempts to take the execution of warps while others running them
+			uint64_t wakeup_needed_count = 0; // wakeups requested while some threads were parked
+			uint64_t wakeup_issued_count = 0; // wakeups that actually unparked a thread
+			uint64_t running_time = 0; // internal threads only, time since start() excluding idle time
+			uint64_t idle_time = 0; // internal threads only, spinning, parking and retired time
+		};
+
+		// counters of simulation mode, see set_simulation()
+		struct simulation_stats_t {
+			uint64_t seed = 0;
+			uint64_t task_count = 0; // tasks executed
+			uint64_t critical_path = 0; // the longest chain of tasks, each queued by the previous one
+			uint64_t virtual_time = 0; // nanoseconds
+			size_t pending_count = 0;
+		};
 
-		iris_async_worker_t() : waiting_thread_count(0), limit_count(0), internal_thread_count(0), finalize_task_head(nullptr) {
+		// per-thread states, only written by the owner thread
+		struct alignas(64) thread_state_t {
+			thread_state_t() noexcept {
+				busy.store(true, std::memory_order_relaxed);
+				switch_inline_count.store(0, std::memory_order_relaxed);
+				switch_queued_count.store(0, std::memory_order_relaxed);
+				spin_hit_count.store(0, std::memory_order_relaxed);
+				spin_miss_count.store(0, std::memory_order_relaxed);
+				spin_time.store(0, std::memory_order_relaxed);
+				park_count.store(0, std::memory_order_relaxed);
+				park_time.store(0, std::memory_order_relaxed);
+				retire_time.store(0, std::memory_order_relaxed);
+				idle_since.store(0, std::memory_order_relaxed);
+				steal_count.store(0, std::memory_order_relaxed);
+				cas_retry_count.store(0, std::memory_order_relaxed);
+				preempt_failure_count.store(0, std::memory_order_relaxed);
+				wakeup_needed_count.store(0, std::memory_order_relaxed);
+				wakeup_issued_count.store(0, std::memory_order_relaxed);
+				depth_peak.store(0, std::memory_order_relaxed);
+			}
+
+			void reset_priority_counters(size_t priority_count) {
+				execute_counts.reset(new std::atomic<uint64_t>[priority_count]);
+				for (size_t i = 0; i < priority_count; i++) {
+					execute_counts[i].store(0, std::memory_order_relaxed);
+				}
+			}
+
+			uint32_t seed = 0; // for selecting steal victims
+			size_t spin_budget = 0;
+			size_t inline_switch_depth = 0;
+			uint64_t start_time = 0; // see get_elapsed_time()
+			std::atomic<bool> busy; // false while the thread is idle, its affinity tasks are only stealable while busy
+			std::atomic<uint64_t> switch_inline_count;
+			std::atomic<uint64_t> switch_queued_count;
+			std::atomic<uint64_t> spin_hit_count;
+			std::atomic<uint64_t> spin_miss_count;
+			std::atomic<uint64_t> spin_time;
+			std::atomic<uint64_t> park_count;
+			std::atomic<uint64_t> park_time;
+			std::atomic<uint64_t> retire_time;
+			std::atomic<uint64_t> idle_since; // start of the ongoing idle period plus one, 0 if running
+			std::atomic<uint64_t> steal_count;
+			std::atomic<uint64_t> cas_retry_count;
+			std::atomic<uint64_t> preempt_failure_count;
+			std::atomic<uint64_t> wakeup_needed_count;
+			std::atomic<uint64_t> wakeup_issued_count;
+			std::atomic<uint64_t> depth_peak;
+			std::unique_ptr<std::atomic<uint64_t>[]> execute_counts; // per priority
+		};
+
+		iris_async_worker_t() : finalize_task_head(nullptr), limit_count(0), internal_thread_count(0), inline_switch_limit(0), work_stealing(false) {
 			task_allocator_index.store(0, std::memory_order_relaxed);
 			running_count.store(0, std::memory_order_relaxed);
+			waiting_thread_count.store(0, std::memory_order_relaxed);
+			external_waiting_count.store(0, std::memory_order_relaxed);
 			task_count.store(0, std::memory_order_relaxed);
+			affinity_task_count.store(0, std::memory_order_relaxed);
+			active_count.store(0, std::memory_order_relaxed);
+			timer_count.store(0, std::memory_order_relaxed);
+			timer_next_tick.store(~uint64_t(0), std::memory_order_relaxed);
+			timer_keeper.store(~size_t(0), std::memory_order_relaxed);
+			timer_epoch = std::chrono::steady_clock::now();
 			terminated.store(1, std::memory_order_release);
 		}
 
@@ -1056,58 +1799,307 @@ namespace iris {
 			internal_thread_count = thread_count;
 		}
 
-		// initialize and start thread poll
-		void start() {
-			IRIS_ASSERT(finalize_task_head == nullptr);
+		// enable per-thread work stealing deques, must be called before start()
+		// tasks queued from worker threads are pushed to their own deques and can be stolen by idle threads
+		// tasks queued from external threads still go through the shared task heads
+		void set_work_stealing(bool enable) noexcept {
 			IRIS_ASSERT(task_heads.empty()); // must not started
+			work_stealing = enable;
+		}
 
-			std::vector<std::atomic<task_t*>> heads(threads.size() * task_head_duplicate_count);
-			for (size_t i = 0; i < heads.size(); i++) {
-				heads[i].store(nullptr, std::memory_order_relaxed);
-			}
+		bool is_work_stealing() const noexcept {
+			return work_stealing;
+		}
+
+		// deterministic simulation: start() spawns no internal thread, all tasks are run one by one by poll() of the driving thread
+		// the next task is picked pseudo-randomly from all pending ones with seed, regardless of the priority,
+		// and runs as the thread it's queued to, or as a random active internal thread if not specified
+		// timers and poll_delay() use a virtual clock, which only advances while poll_delay() finds no task
+		// keep the active count unchanged while simulating, or the same seed may pick different threads
+		// must be called before start()
+		void set_simulation(bool enable, uint64_t seed = 0) noexcept {
+			IRIS_ASSERT(task_heads.empty()); // must not started
+			simulation = enable;
+			simulation_seed = seed;
+		}
+
+		bool is_simulation() const noexcept {
+			return simulation;
+		}
+
+		simulation_stats_t get_simulation_stats() {
+			std::lock_guard<std::mutex> guard(simulation_mutex);
+			simulation_stats_t stats;
+			stats.seed = simulation_seed;
+			stats.task_count = simulation_task_count;
+			stats.critical_path = simulation_critical_path;
+			stats.virtual_time = simulation_time.load(std::memory_order_relaxed);
+			stats.pending_count = simulation_tasks.size();
+			return stats;
+		}
+
+		// initialize and start thread poll
+		void start() {
+			IRIS_ASSERT(finalize_task_head == nullptr);
+			IRIS_ASSERT(task_heads.empty()); // must not started
+
+			std::vector<std::atomic<task_t*>> heads(threads.size() * task_head_duplicate_count);
+			for (size_t i = 0; i < heads.size(); i++) {
+				heads[i].store(nullptr, std::memory_order_relaxed);
+			}
 
 			task_heads = std::move(heads);
+
+			std::vector<std::atomic<task_t*>> inboxes(threads.size() * get_priority_count());
+			for (size_t i = 0; i < inboxes.size(); i++) {
+				inboxes[i].store(nullptr, std::memory_order_relaxed);
+			}
+
+			affinity_heads = std::move(inboxes);
+
+			std::vector<iris_parker_t> thread_parkers(threads.size());
+			parkers = std::move(thread_parkers);
+
+			std::vector<thread_state_t> states(threads.size());
+			uint64_t start_time = get_elapsed_time();
+			for (size_t i = 0; i < states.size(); i++) {
+				states[i].seed = static_cast<uint32_t>(i * 2654435761u + 1u);
+				states[i].spin_budget = idle_policy.spin_min;
+				states[i].start_time = start_time;
+				states[i].reset_priority_counters(get_priority_count());
+			}
+
+			thread_states = std::move(states);
+
+			if (work_stealing) {
+				std::vector<task_deque_t> deques(threads.size() * get_priority_count());
+				task_deques = std::move(deques);
+			}
+
+			active_count.store(internal_thread_count, std::memory_order_relaxed);
+			simulation_state = simulation_seed;
+			simulation_task_count = 0;
+			simulation_critical_path = 0;
 			terminated.store(0, std::memory_order_release);
 
-			for (size_t i = 0; i < internal_thread_count; i++) {
+			for (size_t i = 0; i < internal_thread_count && !simulation; i++) {
 				threads[i] = thread_t([this, i]() {
 					IRIS_PROFILE_THREAD("iris_async_worker", i);
+					if (thread_initializer) {
+						thread_initializer(i);
+					}
+
 					thread_loop(i);
 				});
 			}
 		}
 
 		void make_current(size_t i) noexcept {
-			get_current_thread_index_internal() = i;
+			thread_index_t& index = iris_static_instance_t<thread_index_t>::get_thread_local();
+			index.value = i;
+			index.worker = i == ~size_t(0) ? nullptr : this;
 		}
 
 		void thread_loop(size_t i) {
 			make_current(i);
 
 			while (!is_terminated()) {
-				if (!poll()) {
-					delay();
+				if (is_retired(i)) {
+					retire(i);
+				} else if (!poll_timers() && !poll()) {
+					thread_states[i].busy.store(false, std::memory_order_relaxed);
+					idle(i);
+					thread_states[i].busy.store(true, std::memory_order_relaxed);
 				}
 			}
 
 			make_current(~size_t(0));
 		}
 
+		// set the count of active internal threads in [1, internal thread count], can be called at any time after start()
+		// internal threads with index >= count are retired: they stay parked and never poll
+		// tasks left on their deques and inboxes are taken over by active threads
+		void set_active_count(size_t count) {
+			IRIS_ASSERT(!task_heads.empty()); // must be started
+			count = std::max(std::min(count, internal_thread_count), (size_t)1);
+			size_t previous = active_count.exchange(count, std::memory_order_acq_rel);
+			// pairs with the fence in retire()
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			// wake up revived threads, or idle threads that are going to retire
+			for (size_t i = std::min(previous, count); i < std::max(previous, count); i++) {
+				parkers[i].unpark();
+			}
+
+			// wake up an active thread to take over the remaining tasks of retired threads
+			if (count < previous) {
+				wakeup_one_with_priority(0);
+			}
+		}
+
+		size_t get_active_count() const noexcept {
+			return active_count.load(std::memory_order_acquire);
+		}
+
+		bool is_retired(size_t thread_index) const noexcept {
+			return thread_index < internal_thread_count && thread_index >= active_count.load(std::memory_order_acquire);
+		}
+
+		// set a callback invoked on each internal thread before polling, e.g. for pinning threads
+		// must be called before start()
+		void set_thread_initializer(std::function<void(size_t)>&& initializer) {
+			IRIS_ASSERT(task_heads.empty()); // must not started
+			thread_initializer = std::move(initializer);
+		}
+
+		// set idle policy, must be called before start()
+		void set_idle_policy(const idle_policy_t& policy) noexcept {
+			IRIS_ASSERT(task_heads.empty()); // must not started
+			IRIS_ASSERT(policy.spin_min <= policy.spin_max);
+			idle_policy = policy;
+		}
+
+		const idle_policy_t& get_idle_policy() const noexcept {
+			return idle_policy;
+		}
+
+		// max nested depth of inline switching on one thread, 0 for disabling inline switching
+		// a switch only runs inline if the thread holds no other warp, see iris_switch_t::await_suspend()
+		void set_inline_switch_limit(size_t depth) noexcept {
+			inline_switch_limit = depth;
+		}
+
+		size_t get_inline_switch_limit() const noexcept {
+			return inline_switch_limit;
+		}
+
+		// returns true if current thread is allowed to run a switched coroutine inline
+		// must be paired with leave_inline_switch() on success
+		bool enter_inline_switch() noexcept {
+			size_t owned_thread_index = get_owned_thread_index();
+			if (owned_thread_index != ~size_t(0) && owned_thread_index < thread_states.size()) {
+				thread_state_t& state = thread_states[owned_thread_index];
+				if (state.inline_switch_depth < inline_switch_limit) {
+					state.inline_switch_depth++;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void leave_inline_switch() noexcept {
+			thread_state_t& state = thread_states[get_owned_thread_index()];
+			IRIS_ASSERT(state.inline_switch_depth != 0);
+			state.inline_switch_depth--;
+		}
+
+		void record_switch(bool inlined) noexcept {
+			size_t owned_thread_index = get_owned_thread_index();
+			if (owned_thread_index != ~size_t(0) && owned_thread_index < thread_states.size()) {
+				thread_state_t& state = thread_states[owned_thread_index];
+				accumulate(inlined ? state.switch_inline_count : state.switch_queued_count, 1);
+			}
+		}
+
+		void record_preempt_failure() noexcept {
+			size_t owned_thread_index = get_owned_thread_index();
+			if (owned_thread_index != ~size_t(0) && owned_thread_index < thread_states.size()) {
+				accumulate(thread_states[owned_thread_index].preempt_failure_count, 1);
+			}
+		}
+
+		switch_stats_t get_switch_stats(size_t thread_index) const noexcept {
+			switch_stats_t stats;
+			if (thread_index < thread_states.size()) {
+				const thread_state_t& state = thread_states[thread_index];
+				stats.inline_count = state.switch_inline_count.load(std::memory_order_relaxed);
+				stats.queued_count = state.switch_queued_count.load(std::memory_order_relaxed);
+			}
+
+			return stats;
+		}
+
+		// get idle counters of given thread
+		idle_stats_t get_idle_stats(size_t thread_index) const noexcept {
+			idle_stats_t stats;
+			if (thread_index < thread_states.size()) {
+				const thread_state_t& state = thread_states[thread_index];
+				stats.spin_hit_count = state.spin_hit_count.load(std::memory_order_relaxed);
+				stats.spin_miss_count = state.spin_miss_count.load(std::memory_order_relaxed);
+				stats.spin_time = state.spin_time.load(std::memory_order_relaxed);
+				stats.park_count = state.park_count.load(std::memory_order_relaxed);
+				stats.park_time = state.park_time.load(std::memory_order_relaxed);
+			}
+
+			return stats;
+		}
+
+		// get scheduler counters of given thread, aggregated from its own counters on reading
+		thread_stats_t get_thread_stats(size_t thread_index) const {
+			thread_stats_t stats;
+			if (thread_index < thread_states.size()) {
+				const thread_state_t& state = thread_states[thread_index];
+				size_t priority_count = get_priority_count();
+				stats.execute_counts.resize(priority_count);
+				for (size_t i = 0; i < priority_count; i++) {
+					stats.execute_counts[i] = state.execute_counts[i].load(std::memory_order_relaxed);
+				}
+
+				stats.depth_peak = state.depth_peak.load(std::memory_order_relaxed);
+				stats.steal_count = state.steal_count.load(std::memory_order_relaxed);
+				stats.cas_retry_count = state.cas_retry_count.load(std::memory_order_relaxed);
+				stats.preempt_failure_count = state.preempt_failure_count.load(std::memory_order_relaxed);
+				stats.wakeup_needed_count = state.wakeup_needed_count.load(std::memory_order_relaxed);
+				stats.wakeup_issued_count = state.wakeup_issued_count.load(std::memory_order_relaxed);
+
+				if (thread_index < internal_thread_count) {
+					uint64_t now = get_elapsed_time();
+					uint64_t idle_since = state.idle_since.load(std::memory_order_acquire);
+					uint64_t idle_time = state.spin_time.load(std::memory_order_relaxed) + state.park_time.load(std::memory_order_relaxed) + state.retire_time.load(std::memory_order_relaxed);
+					if (idle_since != 0) {
+						idle_time += now - std::min(idle_since - 1, now);
+					}
+
+					// counters are read without synchronization, so clamp the results
+					uint64_t total_time = now - std::min(state.start_time, now);
+					stats.idle_time = std::min(idle_time, total_time);
+					stats.running_time = total_time - stats.idle_time;
+				}
+			}
+
+			return stats;
+		}
+
 		// guard for exception on wait_for
 		struct waiting_guard_t {
-			waiting_guard_t(iris_async_worker_t* w) noexcept : worker(w) {
-				++worker->waiting_thread_count;
+			waiting_guard_t(std::atomic<size_t>& c) noexcept : counter(c) {
+				counter.fetch_add(1, std::memory_order_seq_cst);
+				// pairs with the fence in wakeup_one_with_priority()
+				std::atomic_thread_fence(std::memory_order_seq_cst);
 			}
 
 			~waiting_guard_t() noexcept {
-				--worker->waiting_thread_count;
+				counter.fetch_sub(1, std::memory_order_release);
 			}
 
 		private:
-			iris_async_worker_t* worker;
+			std::atomic<size_t>& counter;
+		};
+
+		// guard for parking
+		struct parking_guard_t {
+			parking_guard_t(iris_parker_t& p) noexcept : parker(p) {
+				parker.prepare();
+			}
+
+			~parking_guard_t() noexcept {
+				parker.cancel();
+			}
+
+			iris_parker_t& parker;
 		};
 
-		friend struct waiting_guard_t;
 
 		// append new customized thread to worker
 		// must be called before start()
@@ -1140,6 +2132,10 @@ namespace iris {
 
 		// poll any task from thread poll manually
 		bool poll() {
+			if (simulation) {
+				return poll_simulated();
+			}
+
 			size_t inv_priority = running_count.fetch_add(1, std::memory_order_acquire);
 			running_guard_t guard(running_count);
 			return poll_internal(threads.size() + 1 - std::min(inv_priority + 1, threads.size()));
@@ -1147,6 +2143,10 @@ namespace iris {
 
 		// poll any task from thread poll manually with given priority
 		bool poll(size_t priority) {
+			if (simulation) {
+				return poll_simulated();
+			}
+
 			running_count.fetch_add(1, std::memory_order_acquire);
 			running_guard_t guard(running_count);
 			return poll_internal(std::min(priority + 1, threads.size()));
@@ -1156,10 +2156,38 @@ namespace iris {
 		// usually used in your customized thread procedures
 		template <typename duration_t>
 		bool poll_delay(size_t priority, duration_t&& delay) {
+			if (simulation) {
+				if (poll_simulated()) {
+					return true;
+				}
+
+				// idle, jump to the next timer within delay
+				uint64_t now = simulation_time.load(std::memory_order_relaxed);
+				uint64_t target = now + static_cast<uint64_t>(std::max(std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count(), (int64_t)0));
+				uint64_t next_tick = timer_next_tick.load(std::memory_order_relaxed);
+				if (timer_count.load(std::memory_order_relaxed) != 0 && next_tick <= target / 1000000u) {
+					target = std::max(now, next_tick * 1000000u);
+				}
+
+				simulation_time.store(target, std::memory_order_relaxed);
+				return poll_simulated();
+			}
+
 			if (!poll(priority)) {
-				std::unique_lock<std::mutex> lock(mutex);
-				condition.wait_for(lock, std::forward<duration_t>(delay));
-				lock.unlock();
+				size_t owned_thread_index = get_owned_thread_index();
+				if (owned_thread_index != ~size_t(0)) {
+					parking_guard_t parking_guard(parkers[owned_thread_index]);
+					waiting_guard_t guard(waiting_thread_count);
+
+					size_t priority_size = std::min(priority + 1, threads.size());
+					if (fetch(priority_size).first == ~size_t(0) && !fetch_deque(priority_size) && !fetch_affinity(priority_size) && !is_terminated()) {
+						parking_guard.parker.wait_for(std::forward<duration_t>(delay));
+					}
+				} else {
+					std::unique_lock<std::mutex> lock(mutex);
+					waiting_guard_t guard(external_waiting_count);
+					condition.wait_for(lock, std::forward<duration_t>(delay));
+				}
 
 				if (!poll(priority)) {
 					// priority restriction not satisfied, wake up anther thread to solve it
@@ -1228,11 +2256,28 @@ namespace iris {
 				IRIS_ASSERT(!threads.empty());
 				priority = std::min(priority, std::max(internal_thread_count, (size_t)1) - 1u);
 
+				if (simulation) {
+					queue_simulated(task, priority, ~size_t(0));
+					return;
+				}
+
 				// try empty slots first
 				size_t index = 0;
 				ptrdiff_t max_diff = std::numeric_limits<ptrdiff_t>::min();
 				size_t thread_count = threads.size();
 				size_t current_thread_index = get_current_thread_index();
+
+				// local fast path for work stealing
+				if (!task_deques.empty()) {
+					size_t owned_thread_index = get_owned_thread_index();
+					if (owned_thread_index != ~size_t(0)) {
+						task_deques[owned_thread_index * get_priority_count() + priority].push(task);
+						record_queue(0);
+						wakeup_one_with_priority(priority);
+						return;
+					}
+				}
+
 				current_thread_index = current_thread_index == ~size_t(0) ? 0 : current_thread_index;
 
 				for (size_t n = 0; n < task_head_duplicate_count; n++) {
@@ -1241,6 +2286,7 @@ namespace iris {
 					task_t* expected = nullptr;
 					if (task_head.compare_exchange_strong(expected, task, std::memory_order_release)) {
 						// dispatch immediately
+						record_queue(0);
 						wakeup_one_with_priority(priority);
 						return;
 					} else {
@@ -1258,11 +2304,15 @@ namespace iris {
 				// avoid legacy compiler bugs
 				// see https://en.cppreference.com/w/cpp/atomic/atomic/compare_exchange
 				task_t* node = task_head.load(std::memory_order_relaxed);
-				do {
+				size_t retry_count = 0;
+				task->next = node;
+				while (!task_head.compare_exchange_weak(node, task, std::memory_order_acq_rel, std::memory_order_relaxed)) {
 					task->next = node;
-				} while (!task_head.compare_exchange_weak(node, task, std::memory_order_acq_rel, std::memory_order_relaxed));
+					retry_count++;
+				}
 
 				// dispatch immediately
+				record_queue(retry_count);
 				wakeup_one_with_priority(priority);
 			} else {
 				// terminate requested, chain to default task_head at 0
@@ -1286,6 +2336,207 @@ namespace iris {
 			queue_task(new_task(std::forward<callable_t>(callable)), priority);
 		}
 
+		// queue a task to the inbox of preferred thread, other threads can only steal it while the preferred thread is busy
+		// falls back to queue_task() if thread_index is out of range
+		void queue_task_affinity(task_t* task, size_t thread_index, size_t priority = 0) {
+			IRIS_ASSERT(task != nullptr && task->next == nullptr);
+			if (!is_terminated() && thread_index < threads.size() && !is_retired(thread_index)) {
+				priority = std::min(priority, get_priority_count() - 1u);
+				if (simulation) {
+					queue_simulated(task, priority, thread_index);
+					return;
+				}
+
+				std::atomic<task_t*>& task_head = affinity_heads[thread_index * get_priority_count() + priority];
+				affinity_task_count.fetch_add(1, std::memory_order_relaxed);
+
+				// avoid legacy compiler bugs
+				// see https://en.cppreference.com/w/cpp/atomic/atomic/compare_exchange
+				task_t* node = task_head.load(std::memory_order_relaxed);
+				size_t retry_count = 0;
+				task->next = node;
+				while (!task_head.compare_exchange_weak(node, task, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+					task->next = node;
+					retry_count++;
+				}
+
+				record_queue(retry_count);
+
+				// pairs with the fence in waiting_guard_t
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				// wake up the preferred thread, or someone else to steal it if the preferred one is busy
+				if (!wakeup(thread_index) && thread_states[thread_index].busy.load(std::memory_order_relaxed)) {
+					wakeup_one_with_priority(priority);
+				}
+			} else {
+				queue_task(task, priority);
+			}
+		}
+
+		template <typename callable_t>
+		void queue_affinity(callable_t&& callable, size_t thread_index, size_t priority = 0) {
+			queue_task_affinity(new_task(std::forward<callable_t>(callable)), thread_index, priority);
+		}
+
+		// queue a task after given delay with the resolution of one millisecond
+		// timers are serviced by internal threads: the idle one parks with a timeout till the next expiration
+		// expired tasks are queued with given priority, pending ones are queued at once on termination
+		template <typename callable_t, typename duration_t>
+		void queue_timer(callable_t&& callable, duration_t&& delay, size_t priority = 0) {
+			if (is_terminated()) {
+				queue(std::forward<callable_t>(callable), priority);
+				return;
+			}
+
+			int64_t ms = (std::chrono::duration_cast<std::chrono::microseconds>(delay).count() + 999) / 1000;
+			uint64_t tick = get_timer_tick() + static_cast<uint64_t>(std::max(ms, (int64_t)1));
+			bool earlier = false;
+
+			do {
+				std::lock_guard<std::mutex> guard(timer_mutex);
+				timer_wheel.push(tick, timer_task_t { callback_t(std::forward<callable_t>(callable)), priority, simulation_depth.load(std::memory_order_relaxed) });
+				timer_count.fetch_add(1, std::memory_order_relaxed);
+
+				uint64_t next_tick = timer_wheel.get_next_tick();
+				earlier = next_tick < timer_next_tick.load(std::memory_order_relaxed);
+				timer_next_tick.store(next_tick, std::memory_order_relaxed);
+			} while (false);
+
+			// pairs with the fence in waiting_guard_t, either the parking thread sees the timer or we see the keeper
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			size_t keeper = timer_keeper.load(std::memory_order_relaxed);
+			if (keeper == ~size_t(0)) {
+				wakeup_one();
+			} else if (earlier) {
+				wakeup(keeper);
+			}
+		}
+
+		size_t get_timer_count() const noexcept {
+			return timer_count.load(std::memory_order_acquire);
+		}
+
+		// queue expired timer tasks, returns true if any
+		// internal threads call it on each loop, so it costs only a relaxed load if no timer is pending
+		bool poll_timers() {
+			if (timer_count.load(std::memory_order_relaxed) == 0) {
+				return false;
+			}
+
+			uint64_t tick = get_timer_tick();
+			if (tick < timer_next_tick.load(std::memory_order_relaxed)) {
+				return false;
+			}
+
+			// someone else is working on it
+			std::unique_lock<std::mutex> guard(timer_mutex, std::try_to_lock);
+			if (!guard.owns_lock()) {
+				return false;
+			}
+
+			size_t count = 0;
+			uint64_t depth = simulation_depth.load(std::memory_order_relaxed);
+			timer_wheel.advance(tick, [this, &count](timer_task_t&& timer_task) {
+				// expired tasks continue the chain of the task that queued the timer
+				if (simulation) {
+					simulation_depth.store(timer_task.depth, std::memory_order_relaxed);
+				}
+
+				queue(std::move(timer_task.callback), timer_task.priority);
+				count++;
+			});
+
+			if (simulation) {
+				simulation_depth.store(depth, std::memory_order_relaxed);
+			}
+
+			timer_count.fetch_sub(count, std::memory_order_relaxed);
+			timer_next_tick.store(timer_wheel.get_next_tick(), std::memory_order_relaxed);
+			return count != 0;
+		}
+
+		// queue a batch of tasks with given priority, callables in [begin, end) are moved
+		// the batch is published with a single atomic operation and wakes up at most min(batch size, idle) threads
+		template <typename iterator_t>
+		void queue_batch(iterator_t begin, iterator_t end, size_t priority = 0) {
+			if (begin == end) {
+				return;
+			}
+
+			// keep submission order from head to tail
+			task_t* head = new_task(std::move(*begin++));
+			task_t* tail = head;
+			size_t count = 1;
+			while (begin != end) {
+				task_t* task = new_task(std::move(*begin++));
+				tail->next = task;
+				tail = task;
+				count++;
+			}
+
+			queue_task_chain(head, tail, count, priority);
+		}
+
+		// queue a chain of tasks linked by task_t::next
+		void queue_task_chain(task_t* head, task_t* tail, size_t count, size_t priority = 0) {
+			IRIS_ASSERT(head != nullptr && tail != nullptr && tail->next == nullptr);
+			if (!is_terminated() && !simulation) {
+				IRIS_ASSERT(!threads.empty());
+				priority = std::min(priority, std::max(internal_thread_count, (size_t)1) - 1u);
+
+				if (!task_deques.empty()) {
+					size_t owned_thread_index = get_owned_thread_index();
+					if (owned_thread_index != ~size_t(0)) {
+						task_deque_t& deque = task_deques[owned_thread_index * get_priority_count() + priority];
+						// push in reversed order so that the owner pops them in submission order
+						task_t* reversed = nullptr;
+						while (head != nullptr) {
+							task_t* next = head->next;
+							head->next = reversed;
+							reversed = head;
+							head = next;
+						}
+
+						while (reversed != nullptr) {
+							task_t* next = reversed->next;
+							reversed->next = nullptr;
+							deque.push(reversed);
+							reversed = next;
+						}
+
+						record_queue(0);
+						wakeup_with_priority(priority, count);
+						return;
+					}
+				}
+
+				size_t current_thread_index = get_current_thread_index();
+				current_thread_index = current_thread_index == ~size_t(0) ? 0 : current_thread_index;
+				std::atomic<task_t*>& task_head = task_heads[priority + (current_thread_index % task_head_duplicate_count) * threads.size()];
+
+				// avoid legacy compiler bugs
+				// see https://en.cppreference.com/w/cpp/atomic/atomic/compare_exchange
+				task_t* node = task_head.load(std::memory_order_relaxed);
+				size_t retry_count = 0;
+				tail->next = node;
+				while (!task_head.compare_exchange_weak(node, head, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+					tail->next = node;
+					retry_count++;
+				}
+
+				record_queue(retry_count);
+				wakeup_with_priority(priority, count);
+			} else {
+				while (head != nullptr) {
+					task_t* next = head->next;
+					head->next = nullptr;
+					queue_task(head, priority);
+					head = next;
+				}
+			}
+		}
+
 		bool finalize() {
 			IRIS_ASSERT(is_terminated());
 
@@ -1326,11 +2577,15 @@ namespace iris {
 				}
 
 				IRIS_ASSERT(running_count.load(std::memory_order_acquire) == 0);
-				IRIS_ASSERT(waiting_thread_count == 0);
+				IRIS_ASSERT(waiting_thread_count.load(std::memory_order_acquire) == 0);
 				while (!cleanup()) {}
 
 				threads.clear();
 				task_heads.clear();
+				task_deques.clear();
+				affinity_heads.clear();
+				thread_states.clear();
+				parkers.clear();
 				threads.resize(internal_thread_count);
 			}
 
@@ -1338,12 +2593,49 @@ namespace iris {
 		}
 
 		// notify threads in thread pool, usually used for customized threads
+		// the scan reads each parker and only tries to unpark the ones that are parked, so it never writes to busy threads' lines.
+		// it still walks all parkers if none is parked, task queueing avoids that by the waiting_thread_count gate in wakeup_one_with_priority()
 		void wakeup_one() {
-			std::lock_guard<std::mutex> lock(mutex);
-			condition.notify_one();
+			size_t thread_count = parkers.size();
+			if (thread_count != 0) {
+				// start from the neighbor of current thread
+				size_t owned_thread_index = get_owned_thread_index();
+				size_t start = owned_thread_index == ~size_t(0) ? 0 : owned_thread_index + 1;
+				record_wakeup(false);
+				for (size_t i = 0; i < thread_count; i++) {
+					size_t index = (start + i) % thread_count;
+					// another waker may unpark it between the check and the exchange, then go on with the next one
+					if (!is_retired(index) && parkers[index].is_parked() && parkers[index].unpark()) {
+						record_wakeup(true);
+						return;
+					}
+				}
+			}
+
+			if (external_waiting_count.load(std::memory_order_acquire) != 0) {
+				std::lock_guard<std::mutex> lock(mutex);
+				condition.notify_one();
+			}
+		}
+
+		// wake up the specified thread if it's parked, returns false if it's running
+		bool wakeup(size_t thread_index) {
+			if (thread_index < parkers.size()) {
+				record_wakeup(false);
+				if (parkers[thread_index].unpark()) {
+					record_wakeup(true);
+					return true;
+				}
+			}
+
+			return false;
 		}
 
 		void wakeup_all() {
+			for (size_t i = 0; i < parkers.size(); i++) {
+				parkers[i].unpark();
+			}
+
 			std::lock_guard<std::mutex> lock(mutex);
 			condition.notify_all();
 		}
@@ -1351,20 +2643,45 @@ namespace iris {
 		// blocked delay for any task
 		void delay() {
 			if (!is_terminated()) {
-				std::unique_lock<std::mutex> lock(mutex);
-				waiting_guard_t guard(this);
+				size_t owned_thread_index = get_owned_thread_index();
+				if (owned_thread_index != ~size_t(0)) {
+					parking_guard_t parking_guard(parkers[owned_thread_index]);
+					waiting_guard_t guard(waiting_thread_count);
+
+					if (fetch(threads.size()).first == ~size_t(0) && !fetch_deque(threads.size()) && !fetch_affinity(threads.size())) {
+						if (!is_terminated()) {
+							// one internal thread keeps timers by parking with a timeout, others park until waked up
+							size_t keeper = ~size_t(0);
+							if (owned_thread_index < internal_thread_count && timer_count.load(std::memory_order_relaxed) != 0 && timer_keeper.compare_exchange_strong(keeper, owned_thread_index, std::memory_order_seq_cst)) {
+								uint64_t next_tick = timer_next_tick.load(std::memory_order_relaxed);
+								uint64_t tick = get_timer_tick();
+								if (next_tick > tick) {
+									parking_guard.parker.wait_for(std::chrono::milliseconds(std::min(next_tick - tick, (uint64_t)1000)));
+								}
+
+								timer_keeper.store(~size_t(0), std::memory_order_release);
+							} else {
+								parking_guard.parker.wait();
+							}
+						}
+					}
+				} else {
+					std::unique_lock<std::mutex> lock(mutex);
+					waiting_guard_t guard(external_waiting_count);
 
-				if (fetch(threads.size()).first == ~size_t(0)) {
-					if (!is_terminated()) {
-						condition.wait(lock);
+					if (fetch(threads.size()).first == ~size_t(0) && !fetch_deque(threads.size()) && !fetch_affinity(threads.size())) {
+						if (!is_terminated()) {
+							condition.wait(lock);
+						}
 					}
 				}
 			}
 		}
 
 		struct thread_index_t {
-			thread_index_t() noexcept : value(~size_t(0)) {}
+			thread_index_t() noexcept : value(~size_t(0)), worker(nullptr) {}
 			size_t value;
+			const void* worker; // the worker which owns current thread
 		};
 
 	protected:
@@ -1372,9 +2689,177 @@ namespace iris {
 			return iris_static_instance_t<thread_index_t>::get_thread_local().value;
 		}
 
+		// single writer counter
+		static void accumulate(std::atomic<uint64_t>& counter, uint64_t value) noexcept {
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		// single writer high-water mark
+		static void raise_peak(std::atomic<uint64_t>& peak, uint64_t value) noexcept {
+			if (value > peak.load(std::memory_order_relaxed)) {
+				peak.store(value, std::memory_order_relaxed);
+			}
+		}
+
+		// nanoseconds since construction
+		uint64_t get_elapsed_time() const noexcept {
+			if (simulation) {
+				return simulation_time.load(std::memory_order_relaxed);
+			}
+
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timer_epoch).count());
+		}
+
+		// get state of current thread only if current thread belongs to this worker and it's running
+		thread_state_t* get_owned_thread_state() noexcept {
+			size_t owned_thread_index = get_owned_thread_index();
+			return owned_thread_index < thread_states.size() ? &thread_states[owned_thread_index] : nullptr;
+		}
+
+		// counters are kept by the owner thread, tasks queued by other threads are not counted
+		void record_queue(size_t retry_count) noexcept {
+			thread_state_t* state = get_owned_thread_state();
+			if (state != nullptr) {
+				// task_count is shared by all priorities and includes running tasks, so a single peak is kept
+				raise_peak(state->depth_peak, task_count.load(std::memory_order_relaxed));
+				if (retry_count != 0) {
+					accumulate(state->cas_retry_count, retry_count);
+				}
+			}
+		}
+
+		void record_wakeup(bool issued) noexcept {
+			thread_state_t* state = get_owned_thread_state();
+			if (state != nullptr) {
+				accumulate(issued ? state->wakeup_issued_count : state->wakeup_needed_count, 1);
+			}
+		}
+
+		// execute a polled task and count it for the owner thread
+		void execute_polled_task(task_t* task, size_t priority, bool stolen) {
+			thread_state_t* state = get_owned_thread_state();
+			if (state != nullptr) {
+				accumulate(state->execute_counts[std::min(priority, get_priority_count() - 1)], 1);
+				if (stolen) {
+					accumulate(state->steal_count, 1);
+				}
+			}
+
+			execute_task(task);
+		}
+
+		// check if there is any task could be polled by internal threads
+		bool has_task() const noexcept {
+			return fetch(threads.size()).first != ~size_t(0) || fetch_deque(threads.size()) || fetch_affinity(threads.size());
+		}
+
+		// park a retired thread until it's revived or terminated
+		void retire(size_t i) {
+			// its inbox can be stolen only while it's marked as busy
+			thread_states[i].busy.store(true, std::memory_order_relaxed);
+			if (has_task()) {
+				wakeup_one_with_priority(0);
+			}
+
+			// retired threads are not counted as waiting ones, so no one expects them to pick up tasks
+			parking_guard_t parking_guard(parkers[i]);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (is_retired(i) && !is_terminated()) {
+				thread_state_t& state = thread_states[i];
+				uint64_t start = get_elapsed_time();
+				state.idle_since.store(start + 1, std::memory_order_release);
+				parking_guard.parker.wait();
+				accumulate(state.retire_time, get_elapsed_time() - start);
+				state.idle_since.store(0, std::memory_order_release);
+			}
+		}
+
+		// idle routine for internal threads
+		void idle(size_t i) {
+			thread_state_t& state = thread_states[i];
+
+			uint64_t start = get_elapsed_time();
+			state.idle_since.store(start + 1, std::memory_order_release);
+
+			if (idle_policy.spin_max != 0) {
+				size_t budget = state.spin_budget;
+				bool hit = false;
+
+				for (size_t n = 0; n < budget && !hit; n++) {
+					iris_cpu_pause();
+					hit = has_task();
+				}
+
+				for (size_t n = 0; n < idle_policy.yield_count && !hit; n++) {
+					std::this_thread::yield();
+					hit = has_task();
+				}
+
+				uint64_t spin_end = get_elapsed_time();
+				accumulate(state.spin_time, spin_end - start);
+				state.idle_since.store(spin_end + 1, std::memory_order_release);
+				start = spin_end;
+
+				if (hit || is_terminated()) {
+					accumulate(state.spin_hit_count, 1);
+					state.spin_budget = std::min(std::max(budget * 2, (size_t)1), idle_policy.spin_max);
+					state.idle_since.store(0, std::memory_order_release);
+					return;
+				} else {
+					accumulate(state.spin_miss_count, 1);
+					state.spin_budget = std::max(budget / 2, std::max(idle_policy.spin_min, (size_t)1));
+				}
+			}
+
+			delay();
+			accumulate(state.park_count, 1);
+			accumulate(state.park_time, get_elapsed_time() - start);
+			state.idle_since.store(0, std::memory_order_release);
+		}
+
+		// get current thread index only if current thread belongs to this worker
+		size_t get_owned_thread_index() const noexcept {
+			const thread_index_t& index = iris_static_instance_t<thread_index_t>::get_thread_local();
+			return index.worker == this && index.value < threads.size() ? index.value : ~size_t(0);
+		}
+
+		// milliseconds since construction
+		uint64_t get_timer_tick() const noexcept {
+			if (simulation) {
+				return simulation_time.load(std::memory_order_relaxed) / 1000000u;
+			}
+
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timer_epoch).count());
+		}
+
+		size_t get_priority_count() const noexcept {
+			return std::max(internal_thread_count, (size_t)1);
+		}
+
+		// wake up at most count threads
+		void wakeup_with_priority(size_t priority, size_t count) {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			size_t waiting = waiting_thread_count.load(std::memory_order_relaxed);
+			size_t threshold = priority + limit_count;
+			if (waiting > threshold) {
+				count = std::min(count, waiting - threshold);
+				for (size_t i = 0; i < count; i++) {
+					wakeup_one();
+				}
+			} else if (external_waiting_count.load(std::memory_order_relaxed) != 0) {
+				std::lock_guard<std::mutex> lock(mutex);
+				condition.notify_all();
+			}
+		}
+
 		void wakeup_one_with_priority(size_t priority) {
-			if (waiting_thread_count > priority + limit_count) {
+			// pairs with the fence in waiting_guard_t, either the waiter sees the new task or we see the waiter
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiting_thread_count.load(std::memory_order_relaxed) > priority + limit_count) {
 				wakeup_one();
+			} else if (external_waiting_count.load(std::memory_order_relaxed) != 0) {
+				std::lock_guard<std::mutex> lock(mutex);
+				condition.notify_one();
 			}
 		}
 
@@ -1383,6 +2868,16 @@ namespace iris {
 			IRIS_PROFILE_SCOPE(__FUNCTION__);
 
 			bool empty = true;
+			if (timer_count.load(std::memory_order_acquire) != 0) {
+				std::lock_guard<std::mutex> guard(timer_mutex);
+				timer_wheel.clear([this](timer_task_t&& timer_task) {
+					queue(std::move(timer_task.callback), timer_task.priority);
+				});
+
+				timer_count.store(0, std::memory_order_relaxed);
+				timer_next_tick.store(~uint64_t(0), std::memory_order_relaxed);
+				empty = false;
+			}
 			for (size_t i = 0; i < task_heads.size(); i++) {
 				std::atomic<task_t*>& task_head = task_heads[i];
 				task_t* task = task_head.exchange(nullptr, std::memory_order_acquire);
@@ -1413,6 +2908,30 @@ namespace iris {
 				}
 			}
 
+			for (size_t i = 0; i < affinity_heads.size(); i++) {
+				task_t* task = pop_affinity_task(affinity_heads[i], 0);
+				while (task != nullptr) {
+					empty = false;
+					execute_task(task);
+					task = pop_affinity_task(affinity_heads[i], 0);
+				}
+			}
+
+			for (simulated_task_t simulated : take_simulated_tasks()) {
+				empty = false;
+				execute_task(simulated.task);
+			}
+
+			// all threads are joined, so it's safe to pop from any deque
+			for (size_t i = 0; i < task_deques.size(); i++) {
+				task_t* task = task_deques[i].pop();
+				while (task != nullptr) {
+					empty = false;
+					execute_task(task);
+					task = task_deques[i].pop();
+				}
+			}
+
 			return empty;
 		}
 
@@ -1434,50 +2953,302 @@ namespace iris {
 			return std::make_pair(~size_t(0), ~size_t(0));
 		}
 
-		// poll with given priority
-		bool poll_internal(size_t priority_size) {
-			IRIS_PROFILE_SCOPE(__FUNCTION__);
+		// check if any deque has tasks with given priority
+		bool fetch_deque(size_t priority_size) const noexcept {
+			size_t priority_count = get_priority_count();
+			priority_size = std::min(priority_size, priority_count);
+
+			for (size_t i = 0; i < task_deques.size(); i += priority_count) {
+				for (size_t n = 0; n < priority_size; n++) {
+					if (!task_deques[i + n].empty()) {
+						return true;
+					}
+				}
+			}
 
-			std::pair<size_t, size_t> slot = fetch(priority_size);
-			size_t index = slot.first;
+			return false;
+		}
 
-			if (index != ~size_t(0)) {
-				size_t priority = slot.second;
-				std::atomic<task_t*>& task_head = task_heads[index];
-				if (task_head.load(std::memory_order_acquire) != nullptr) {
-					// fetch a task atomically
-					task_t* task = task_head.exchange(nullptr, std::memory_order_acquire);
-					if (task != nullptr) {
-						task_t* org = task_head.exchange(task->next, std::memory_order_release);
+		// check if there is any affinity task could be polled by current thread with given priority
+		bool fetch_affinity(size_t priority_size) const noexcept {
+			if (affinity_task_count.load(std::memory_order_acquire) == 0) {
+				return false;
+			}
 
-						// return the remaining
-						if (org != nullptr) {
-							do {
-								task_t* next = org->next;
+			size_t priority_count = get_priority_count();
+			size_t owned_thread_index = get_owned_thread_index();
+			priority_size = std::min(priority_size, priority_count);
+
+			for (size_t i = 0; i < affinity_heads.size(); i += priority_count) {
+				size_t thread_index = i / priority_count;
+				if (thread_index == owned_thread_index || thread_states[thread_index].busy.load(std::memory_order_relaxed)) {
+					for (size_t n = 0; n < priority_size; n++) {
+						if (affinity_heads[i + n].load(std::memory_order_acquire) != nullptr) {
+							return true;
+						}
+					}
+				}
+			}
 
-								// avoid legacy compiler bugs
-								// see https://en.cppreference.com/w/cpp/atomic/atomic/compare_exchange
-								task_t* node = task_head.load(std::memory_order_relaxed);
-								do {
-									org->next = node;
-								} while (!task_head.compare_exchange_weak(node, org, std::memory_order_relaxed, std::memory_order_relaxed));
+			return false;
+		}
 
-								org = next;
-							} while (org != nullptr);
+		task_t* pop_affinity_task(std::atomic<task_t*>& task_head, size_t priority) {
+			task_t* task = pop_task(task_head, priority);
+			if (task != nullptr) {
+				affinity_task_count.fetch_sub(1, std::memory_order_relaxed);
+			}
 
-							std::atomic_thread_fence(std::memory_order_acq_rel);
-							wakeup_one_with_priority(priority);
+			return task;
+		}
+
+		// poll own inbox first, then inboxes of busy threads if stealing
+		task_t* steal_affinity_task(size_t priority_size, bool stealing, size_t& priority) {
+			if (affinity_task_count.load(std::memory_order_acquire) == 0) {
+				return nullptr;
+			}
+
+			size_t thread_count = threads.size();
+			size_t priority_count = get_priority_count();
+			size_t owned_thread_index = get_owned_thread_index();
+			priority_size = std::min(priority_size, priority_count);
+
+			if (!stealing) {
+				if (owned_thread_index != ~size_t(0)) {
+					for (size_t n = 0; n < priority_size; n++) {
+						task_t* task = pop_affinity_task(affinity_heads[owned_thread_index * priority_count + n], n);
+						if (task != nullptr) {
+							priority = n;
+							return task;
+						}
+					}
+				}
+			} else {
+				size_t start = owned_thread_index == ~size_t(0) ? 0 : owned_thread_index + 1;
+				for (size_t m = 0; m < thread_count; m++) {
+					size_t victim = (start + m) % thread_count;
+					if (victim != owned_thread_index && thread_states[victim].busy.load(std::memory_order_relaxed)) {
+						for (size_t n = 0; n < priority_size; n++) {
+							task_t* task = pop_affinity_task(affinity_heads[victim * priority_count + n], n);
+							if (task != nullptr) {
+								priority = n;
+								return task;
+							}
 						}
+					}
+				}
+			}
 
-						// in case task->task() throws exceptions
-						execute_task(task);
+			return nullptr;
+		}
+
+		// pop a task from given task head, returns nullptr if lost the race
+		task_t* pop_task(std::atomic<task_t*>& task_head, size_t priority) {
+			if (task_head.load(std::memory_order_acquire) != nullptr) {
+				// fetch a task atomically
+				task_t* task = task_head.exchange(nullptr, std::memory_order_acquire);
+				if (task != nullptr) {
+					task_t* org = task_head.exchange(task->next, std::memory_order_release);
+
+					// return the remaining
+					if (org != nullptr) {
+						do {
+							task_t* next = org->next;
+
+							// avoid legacy compiler bugs
+							// see https://en.cppreference.com/w/cpp/atomic/atomic/compare_exchange
+							task_t* node = task_head.load(std::memory_order_relaxed);
+							do {
+								org->next = node;
+							} while (!task_head.compare_exchange_weak(node, org, std::memory_order_relaxed, std::memory_order_relaxed));
+
+							org = next;
+						} while (org != nullptr);
+
+						std::atomic_thread_fence(std::memory_order_acq_rel);
+						wakeup_one_with_priority(priority);
 					}
+
+					task->next = nullptr;
+					return task;
 				}
+			}
+
+			return nullptr;
+		}
+
+		// try popping local deque first, then shared task heads, then steal from a random victim
+		task_t* steal_task(size_t priority, bool& stolen) {
+			size_t thread_count = threads.size();
+			size_t owned_thread_index = get_owned_thread_index();
+			size_t priority_count = get_priority_count();
+
+			if (owned_thread_index != ~size_t(0)) {
+				task_t* task = task_deques[owned_thread_index * priority_count + priority].pop();
+				if (task != nullptr) {
+					return task;
+				}
+			}
+
+			size_t current_thread_index = owned_thread_index == ~size_t(0) ? 0 : owned_thread_index;
+			for (size_t k = 0; k < task_head_duplicate_count; k++) {
+				size_t i = ((k + current_thread_index) % task_head_duplicate_count) * thread_count + priority;
+				task_t* task = pop_task(task_heads[i], priority);
+				if (task != nullptr) {
+					return task;
+				}
+			}
+
+			size_t start;
+			if (owned_thread_index != ~size_t(0)) {
+				// xorshift32
+				uint32_t& seed = thread_states[owned_thread_index].seed;
+				seed ^= seed << 13;
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				start = seed;
+			} else {
+				start = task_allocator_index.load(std::memory_order_relaxed);
+			}
+
+			for (size_t m = 0; m < thread_count; m++) {
+				size_t victim = (start + m) % thread_count;
+				if (victim != owned_thread_index) {
+					task_t* task = task_deques[victim * priority_count + priority].steal();
+					if (task != nullptr) {
+						stolen = true;
+						return task;
+					}
+				}
+			}
+
+			return nullptr;
+		}
+
+		struct simulated_task_t {
+			task_t* task;
+			size_t priority;
+			size_t thread_index; // ~size_t(0) for any active internal thread
+			uint64_t depth; // length of the chain of tasks that queued it
+		};
 
+		// splitmix64, guarded by simulation_mutex
+		uint64_t next_simulation_random() noexcept {
+			uint64_t z = (simulation_state += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			return z ^ (z >> 31);
+		}
+
+		void queue_simulated(task_t* task, size_t priority, size_t thread_index) {
+			do {
+				std::lock_guard<std::mutex> guard(simulation_mutex);
+				simulation_tasks.emplace_back(simulated_task_t { task, priority, thread_index, simulation_depth.load(std::memory_order_relaxed) + 1 });
+			} while (false);
+
+			record_queue(0);
+		}
+
+		std::vector<simulated_task_t> take_simulated_tasks() {
+			std::lock_guard<std::mutex> guard(simulation_mutex);
+			return std::move(simulation_tasks);
+		}
+
+		// restores the thread index and task depth of the driving thread, even if the task throws
+		struct simulation_guard_t {
+			simulation_guard_t(iris_async_worker_t& w, size_t thread_index, uint64_t depth) noexcept : worker(w), index(iris_static_instance_t<thread_index_t>::get_thread_local()), previous_index(index), previous_depth(w.simulation_depth.load(std::memory_order_relaxed)) {
+				index.value = thread_index;
+				index.worker = &worker;
+				worker.simulation_depth.store(depth, std::memory_order_relaxed);
+			}
+
+			~simulation_guard_t() noexcept {
+				index = previous_index;
+				worker.simulation_depth.store(previous_depth, std::memory_order_relaxed);
+			}
+
+			iris_async_worker_t& worker;
+			thread_index_t& index;
+			thread_index_t previous_index;
+			uint64_t previous_depth;
+		};
+
+		// run one pending task picked by the seeded generator
+		bool poll_simulated() {
+			poll_timers();
+
+			simulated_task_t simulated;
+			do {
+				std::lock_guard<std::mutex> guard(simulation_mutex);
+				if (simulation_tasks.empty()) {
+					return false;
+				}
+
+				size_t index = static_cast<size_t>(next_simulation_random() % simulation_tasks.size());
+				simulated = simulation_tasks[index];
+				simulation_tasks[index] = simulation_tasks.back();
+				simulation_tasks.pop_back();
+
+				if (simulated.thread_index == ~size_t(0)) {
+					size_t count = std::min(std::max(active_count.load(std::memory_order_relaxed), (size_t)1), threads.size());
+					simulated.thread_index = static_cast<size_t>(next_simulation_random() % count);
+				}
+
+				simulation_task_count++;
+				simulation_critical_path = std::max(simulation_critical_path, simulated.depth);
+			} while (false);
+
+			simulation_guard_t guard(*this, simulated.thread_index, simulated.depth);
+			execute_polled_task(simulated.task, simulated.priority, false);
+			return true;
+		}
+
+		// poll with given priority
+		bool poll_internal(size_t priority_size) {
+			IRIS_PROFILE_SCOPE(__FUNCTION__);
+
+			// tasks with affinity to current thread go first
+			size_t priority = 0;
+			task_t* task = steal_affinity_task(priority_size, false, priority);
+			if (task != nullptr) {
+				execute_polled_task(task, priority, false);
 				return true;
+			}
+
+			if (!task_deques.empty()) {
+				size_t priority_count = std::min(priority_size, get_priority_count());
+				for (size_t n = 0; n < priority_count; n++) {
+					bool stolen = false;
+					task = steal_task(n, stolen);
+					if (task != nullptr) {
+						// in case task->task() throws exceptions
+						execute_polled_task(task, n, stolen);
+						return true;
+					}
+				}
 			} else {
-				return false;
+				std::pair<size_t, size_t> slot = fetch(priority_size);
+				size_t index = slot.first;
+
+				if (index != ~size_t(0)) {
+					task = pop_task(task_heads[index], slot.second);
+					if (task != nullptr) {
+						// in case task->task() throws exceptions
+						execute_polled_task(task, slot.second, false);
+					}
+
+					return true;
+				}
 			}
+
+			// help busy threads
+			task = steal_affinity_task(priority_size, true, priority);
+			if (task != nullptr) {
+				execute_polled_task(task, priority, true);
+				return true;
+			}
+
+			return false;
 		}
 
 	protected:
@@ -1487,19 +3258,53 @@ namespace iris {
 		std::atomic<size_t> running_count; // running_count
 		std::atomic<size_t> task_count; // the count of total waiting tasks 
 		std::vector<std::atomic<task_t*>> task_heads; // task pointer list
+		std::vector<task_deque_t> task_deques; // per-thread work stealing deques, indexed by thread * priority_count + priority
+		std::vector<std::atomic<task_t*>> affinity_heads; // per-thread inboxes for tasks with thread affinity, indexed by thread * priority_count + priority
+		std::atomic<size_t> affinity_task_count; // the count of tasks in affinity inboxes
+		std::vector<thread_state_t> thread_states; // per-thread states
 		task_t* finalize_task_head;
+		std::vector<iris_parker_t> parkers; // per-thread parking slots
 		std::mutex mutex; // mutex to protect condition
-		std::condition_variable condition; // condition variable for idle wait
+		std::condition_variable condition; // condition variable for idle wait of external threads
 		std::atomic<size_t> terminated; // is to terminate
-		size_t waiting_thread_count; // thread count of waiting on condition variable
+		std::atomic<size_t> waiting_thread_count; // thread count of parking
+		std::atomic<size_t> external_waiting_count; // external thread count of waiting on condition variable
 		size_t limit_count; // limit the count of concurrently running thread
 		size_t internal_thread_count; // the count of internal thread
+		std::atomic<size_t> active_count; // internal threads with index >= active_count are retired
+		size_t inline_switch_limit; // max nested depth of inline switching
+		bool work_stealing; // use per-thread work stealing deques
+		idle_policy_t idle_policy; // idle policy for internal threads
+		std::function<void(size_t)> thread_initializer; // called on each internal thread before polling
+
+		struct timer_task_t {
+			callback_t callback;
+			size_t priority;
+			uint64_t depth; // see simulated_task_t
+		};
+
+		std::mutex timer_mutex; // protects timer_wheel
+		iris_timer_wheel_t<timer_task_t> timer_wheel; // ticks in milliseconds since timer_epoch
+		std::atomic<size_t> timer_count; // pending timers
+		std::atomic<uint64_t> timer_next_tick; // the tick that timer_wheel should advance to
+		std::atomic<size_t> timer_keeper; // the parking thread waiting for next_tick, ~size_t(0) for none
+		std::chrono::steady_clock::time_point timer_epoch;
+
+		bool simulation = false; // see set_simulation()
+		std::mutex simulation_mutex; // tasks may still be queued by external threads
+		std::vector<simulated_task_t> simulation_tasks;
+		uint64_t simulation_seed = 0;
+		uint64_t simulation_state = 0;
+		uint64_t simulation_task_count = 0;
+		uint64_t simulation_critical_path = 0;
+		std::atomic<uint64_t> simulation_depth = 0; // depth of the running task, 0 outside tasks
+		std::atomic<uint64_t> simulation_time = 0; // virtual nanoseconds, never reset so that timer ticks keep increasing
 	};
 
 	template <typename async_worker_t>
 	struct iris_async_balancer_t {
-		iris_async_balancer_t(async_worker_t& worker, size_t size = 4u) : async_worker(worker), current_limit(0), window_size(static_cast<ptrdiff_t>(size)) {
-			async_worker.limit(current_limit);
+		// the limit of worker is left untouched, pass its current value as initial_limit to adopt it
+		iris_async_balancer_t(async_worker_t& worker, size_t size = 4u, size_t initial_limit = 0) : async_worker(worker), current_limit(initial_limit), window_size(static_cast<ptrdiff_t>(size)) {
 			balance.store(0, std::memory_order_release);
 		}
 
@@ -169,12 +169,429 @@ static coroutine_t example_quota(quota_queue_t& q) {
 	}
 }
 
+coroutine_int_t example_frame(int value) {
+	co_return value + 1;
+}
+
+// coroutine frames come from iris_default_frame_pool_t
+static void example_frame_pool() {
+	static constexpr size_t round_count = 1024;
+	iris_default_frame_pool_t::stats_t before = iris_default_frame_pool_t::get_stats();
+
+	int sum = 0;
+	for (size_t i = 0; i < round_count; i++) {
+		example_frame(0).complete([&sum](int&& value) {
+			sum += value;
+		}).run();
+	}
+
+	iris_default_frame_pool_t::stats_t after = iris_default_frame_pool_t::get_stats();
+	printf("Frame pool: hit %d, miss %d, large %d, live %d, block %d\n", (int)after.hit_count, (int)after.miss_count, (int)after.large_count, (int)after.live_count, (int)after.block_count);
+	IRIS_ASSERT(after.hit_count + after.miss_count + after.large_count - before.hit_count - before.miss_count - before.large_count == round_count);
+	IRIS_ASSERT(after.hit_count - before.hit_count >= round_count - 1);
+	IRIS_ASSERT(after.live_count == before.live_count);
+	IRIS_ASSERT(sum == round_count);
+}
+
+coroutine_t example_ping_pong(worker_t& async_worker, warp_t* first, warp_t* second, size_t round_count) {
+	warp_t* current = co_await iris_switch(first);
+	for (size_t i = 0; i < round_count; i++) {
+		co_await iris_switch(second);
+		IRIS_ASSERT(warp_t::get_current_warp() == second);
+		co_await iris_switch(first);
+		IRIS_ASSERT(warp_t::get_current_warp() == first);
+	}
+
+	co_await iris_switch(current);
+	async_worker.terminate();
+}
+
+// switching to an idle warp runs inline without queueing, unless the thread holds another warp
+static void example_inline_switch() {
+	static constexpr size_t round_count = 256;
+	worker_t worker(2);
+	worker.set_inline_switch_limit(4);
+	worker.start();
+
+	std::vector<warp_t> warps;
+	warps.reserve(2);
+	warps.emplace_back(worker);
+	warps.emplace_back(worker);
+
+	worker.queue([&worker, &warps]() {
+		example_ping_pong(worker, &warps[0], &warps[1], round_count).run();
+	});
+
+	while (!worker.is_terminated()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	worker_t::switch_stats_t total;
+	for (size_t i = 0; i < worker.get_thread_count(); i++) {
+		worker_t::switch_stats_t stats = worker.get_switch_stats(i);
+		total.inline_count += stats.inline_count;
+		total.queued_count += stats.queued_count;
+	}
+
+	printf("Inline switch: inline %d, queued %d\n", (int)total.inline_count, (int)total.queued_count);
+	IRIS_ASSERT(total.inline_count + total.queued_count >= round_count * 2);
+	IRIS_ASSERT(total.inline_count != 0);
+	IRIS_ASSERT(total.queued_count >= round_count * 2); // ping-pong switches always leave a held warp
+
+	worker.join();
+	while (!worker.finalize() || !warp_t::join(warps.begin(), warps.end(), [] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); })) {}
+}
+
+coroutine_int_t example_sleep_value(worker_t& async_worker) {
+	co_await iris_sleep<warp_t>(async_worker, std::chrono::milliseconds(5));
+	co_return 4321;
+}
+
+coroutine_t example_sleep(worker_t& async_worker, warp_t* warp, iris_event_t<warp_t>& event) {
+	co_await iris_switch(warp);
+	auto start = std::chrono::steady_clock::now();
+	co_await iris_sleep<warp_t>(async_worker, std::chrono::milliseconds(20));
+	IRIS_ASSERT(warp_t::get_current_warp() == warp);
+	int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	printf("Slept %d ms\n", (int)ms);
+	IRIS_ASSERT(ms >= 20);
+
+	// the event is never notified in time
+	bool signaled = co_await iris_timeout<warp_t>(async_worker, event, std::chrono::milliseconds(10));
+	IRIS_ASSERT(!signaled);
+	IRIS_ASSERT(warp_t::get_current_warp() == warp);
+
+	std::optional<int> value = co_await iris_timeout<warp_t>(async_worker, example_sleep_value(async_worker), std::chrono::seconds(10));
+	IRIS_ASSERT(value && *value == 4321);
+	IRIS_ASSERT(warp_t::get_current_warp() == warp);
+
+	value = co_await iris_timeout<warp_t>(async_worker, example_sleep_value(async_worker), std::chrono::milliseconds(1));
+	IRIS_ASSERT(!value);
+	printf("Timeout checked\n");
+
+	// finish the abandoned waiting
+	event.notify();
+	co_await iris_sleep<warp_t>(async_worker, std::chrono::milliseconds(10));
+	async_worker.terminate();
+}
+
+// timers are serviced by idle threads
+static void example_timer() {
+	worker_t worker(2);
+	worker.start();
+
+	std::vector<warp_t> warps;
+	warps.emplace_back(worker);
+	iris_event_t<warp_t> event(worker);
+
+	worker.queue([&worker, &warps, &event]() {
+		example_sleep(worker, &warps[0], event).run();
+	});
+
+	while (!worker.is_terminated()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	worker.join();
+	while (!worker.finalize() || !warp_t::join(warps.begin(), warps.end(), [] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); })) {}
+}
+
+static coroutine_t example_quota_wait(quota_queue_t& q, iris_cancel_token_t& token) {
+	auto holder = co_await q.guard({ 1, 1 });
+	IRIS_ASSERT(holder);
+
+	q.get_async_worker().queue_timer([&token]() {
+		printf("Cancel quota waiting!\n");
+		token.cancel();
+	}, std::chrono::milliseconds(10));
+
+	// no quota available, only cancellation can resume us
+	auto waiting = co_await q.guard({ 1, 1 }, &token);
+	IRIS_ASSERT(!waiting);
+	IRIS_ASSERT(token.is_cancelled());
+
+	// already cancelled, never suspends
+	auto skipped = co_await q.guard({ 1, 1 }, &token);
+	IRIS_ASSERT(!skipped);
+
+	// the cancelled waiter is skipped on release
+	holder.clear();
+	auto next = co_await q.guard({ 1, 1 });
+	IRIS_ASSERT(next);
+	IRIS_ASSERT(q.get_amount()[0] == 0);
+	next.clear();
+
+	q.get_async_worker().terminate();
+}
+
+// cancel a pending quota waiting
+static void example_quota_cancel() {
+	worker_t worker(2);
+	worker.start();
+
+	quota_t quota({ 1, 1 });
+	quota_queue_t quota_queue(worker, quota);
+	iris_cancel_token_t token;
+	worker.queue([&quota_queue, &token]() {
+		example_quota_wait(quota_queue, token).run();
+	});
+
+	while (!worker.is_terminated()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	worker.join();
+	while (!worker.finalize()) {}
+	IRIS_ASSERT(quota.get()[0] == 1 && quota.get()[1] == 1);
+}
+
+static coroutine_t example_quota_fair_wait(quota_queue_t& q, int amount, size_t priority, std::atomic<int>& granted, iris_event_t<warp_t>& done, size_t tag = 0) {
+	auto holder = co_await q.guard({ amount, 0 }, nullptr, priority, tag);
+	IRIS_ASSERT(holder);
+	granted.store(1, std::memory_order_release);
+	co_await done;
+}
+
+// bounded bypassing and priority classes of quota queue
+static void example_quota_fair() {
+	worker_t worker(2);
+	worker.start();
+
+	quota_t quota({ 4, 1 });
+	quota_queue_t quota_queue(worker, quota, 2, 2, 2);
+	iris_event_t<warp_t> small_done(worker);
+	iris_event_t<warp_t> big_done(worker);
+	big_done.notify();
+
+	auto wait = [] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); };
+	auto launch = [&worker, &quota_queue](int amount, size_t priority, std::atomic<int>& granted, iris_event_t<warp_t>& done, size_t tag = 0) {
+		worker.queue([&quota_queue, amount, priority, &granted, &done, tag]() {
+			example_quota_fair_wait(quota_queue, amount, priority, granted, done, tag).run();
+		});
+	};
+
+	std::atomic<int> big = 0, small1 = 0, small2 = 0, small3 = 0;
+	bool held = quota_queue.acquire({ 4, 0 });
+	IRIS_ASSERT(held);
+	launch(4, 0, big, big_done);
+	wait();
+	launch(1, 0, small1, small_done);
+	launch(1, 0, small2, small_done);
+	launch(1, 0, small3, small_done);
+	wait();
+
+	// the small ones bypass the big one at most twice
+	quota_queue.release({ 2, 0 });
+	wait();
+	IRIS_ASSERT(small1 + small2 + small3 == 2 && !big);
+
+	// the starving big one blocks the rest, even if they fit
+	quota_queue.release({ 1, 0 });
+	wait();
+	IRIS_ASSERT(small1 + small2 + small3 == 2 && !big);
+	IRIS_ASSERT(!quota_queue.acquire_unqueued({ 1, 0 }));
+
+	small_done.notify();
+	wait();
+	quota_queue.release({ 1, 0 });
+	wait();
+	IRIS_ASSERT(big && small1 && small2 && small3);
+	IRIS_ASSERT(quota.get()[0] == 4);
+
+	// higher priority goes first
+	std::atomic<int> low = 0, high = 0;
+	small_done.reset();
+	held = quota_queue.acquire({ 4, 0 });
+	IRIS_ASSERT(held);
+	launch(1, 1, low, small_done);
+	wait();
+	launch(1, 0, high, small_done);
+	wait();
+	quota_queue.release({ 1, 0 });
+	wait();
+	IRIS_ASSERT(high && !low);
+	quota_queue.release({ 3, 0 });
+	wait();
+	IRIS_ASSERT(high && low);
+	small_done.notify();
+	wait();
+	IRIS_ASSERT(quota.get()[0] == 4);
+	printf("Quota fairness checked\n");
+
+	// raising the total amount wakes up waiters, lowering below usage leaves debts
+	std::atomic<int> raised = 0;
+	small_done.reset();
+	launch(6, 0, raised, small_done, 1);
+	wait();
+	IRIS_ASSERT(!raised);
+	quota_queue.raise({ 2, 0 });
+	wait();
+	IRIS_ASSERT(raised && quota.get()[0] == 0);
+	IRIS_ASSERT(quota_queue.get_usage(1)[0] == 6 && quota_queue.get_usage(0)[0] == 0);
+	quota_queue.lower({ 3, 0 });
+	IRIS_ASSERT(quota.get_debt()[0] == 3);
+	small_done.notify();
+	wait();
+	IRIS_ASSERT(quota.get()[0] == 3 && quota.get_debt()[0] == 0);
+	IRIS_ASSERT(quota_queue.get_usage(1)[0] == 0);
+	printf("Quota budget checked\n");
+
+	worker.terminate();
+	worker.join();
+	while (!worker.finalize()) {}
+}
+
+coroutine_int_t example_when_value(worker_t& async_worker, warp_t* warp, int value, int ms) {
+	co_await iris_switch(warp);
+	co_await iris_sleep<warp_t>(async_worker, std::chrono::milliseconds(ms));
+	co_return value;
+}
+
+coroutine_t example_when_void(warp_t* warp) {
+	co_await iris_switch(warp);
+}
+
+static coroutine_t example_when(worker_t& async_worker, std::vector<warp_t>& warps) {
+	co_await iris_switch(&warps[0]);
+
+	// resumed once on warps[0] after all completed
+	auto [a, b, c] = co_await iris_when_all<warp_t>(async_worker, example_when_value(async_worker, &warps[1], 1, 5), example_when_value(async_worker, &warps[2], 2, 1), example_when_void(&warps[1]));
+	IRIS_ASSERT(warp_t::get_current_warp() == &warps[0]);
+	IRIS_ASSERT(a == 1 && b == 2 && c);
+
+	// completed synchronously
+	auto [d] = co_await iris_when_all<warp_t>(async_worker, example_empty());
+	IRIS_ASSERT(d == 1);
+
+	auto first = co_await iris_when_any<warp_t>(async_worker, example_when_value(async_worker, &warps[1], 3, 50), example_when_value(async_worker, &warps[2], 4, 1));
+	IRIS_ASSERT(warp_t::get_current_warp() == &warps[0]);
+	IRIS_ASSERT(first.first == 1 && first.second == 4);
+	printf("When all/any checked\n");
+
+	// wait for the slow one
+	co_await iris_sleep<warp_t>(async_worker, std::chrono::milliseconds(80));
+	async_worker.terminate();
+}
+
+static void example_when_all_any() {
+	worker_t worker(2);
+	worker.start();
+
+	std::vector<warp_t> warps;
+	warps.reserve(3);
+	for (size_t i = 0; i < 3; i++) {
+		warps.emplace_back(worker);
+	}
+
+	worker.queue([&worker, &warps]() {
+		example_when(worker, warps).run();
+	});
+
+	while (!worker.is_terminated()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	worker.join();
+	while (!worker.finalize() || !warp_t::join(warps.begin(), warps.end(), [] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); })) {}
+}
+
+static coroutine_t example_parallel(worker_t& async_worker, warp_t* warp, size_t rounds, std::atomic<int64_t>& elapsed) {
+	co_await iris_switch(warp);
+
+	std::vector<uint32_t> values(1 << 16, 0);
+	co_await iris_parallel_for<warp_t>(async_worker, size_t(0), values.size(), size_t(1024), [&values](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			values[i] = iris_verify_cast<uint32_t>(i);
+		}
+	});
+
+	IRIS_ASSERT(warp_t::get_current_warp() == warp);
+	for (size_t i = 0; i < values.size(); i++) {
+		IRIS_ASSERT(values[i] == i);
+	}
+
+	// combined in range order, so non-commutative combination is allowed
+	std::vector<size_t> order = co_await iris_parallel_reduce<warp_t>(async_worker, size_t(0), size_t(100), size_t(7), std::vector<size_t>(), [](size_t begin, size_t end) {
+		std::vector<size_t> v;
+		for (size_t i = begin; i < end; i++) {
+			v.emplace_back(i);
+		}
+
+		return v;
+	}, [](std::vector<size_t>&& lhs, std::vector<size_t>&& rhs) {
+		lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+		return std::move(lhs);
+	});
+
+	IRIS_ASSERT(warp_t::get_current_warp() == warp);
+	IRIS_ASSERT(order.size() == 100);
+	for (size_t i = 0; i < order.size(); i++) {
+		IRIS_ASSERT(order[i] == i);
+	}
+
+	// empty range never suspends
+	int empty = co_await iris_parallel_reduce<warp_t>(async_worker, 5, 5, 1, 1234, [](int, int) { return 0; }, [](int lhs, int rhs) { return lhs + rhs; });
+	IRIS_ASSERT(empty == 1234);
+
+	// microbenchmark: compute-bound reduction
+	auto start = std::chrono::steady_clock::now();
+	double sum = 0;
+	for (size_t k = 0; k < rounds; k++) {
+		sum += co_await iris_parallel_reduce<warp_t>(async_worker, size_t(0), size_t(1) << 20, size_t(1) << 12, 0.0, [](size_t begin, size_t end) {
+			double s = 0;
+			for (size_t i = begin; i < end; i++) {
+				s += std::sqrt(static_cast<double>(i));
+			}
+
+			return s;
+		}, [](double lhs, double rhs) { return lhs + rhs; });
+	}
+
+	elapsed.store(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_release);
+	IRIS_ASSERT(sum > 0);
+	async_worker.terminate();
+}
+
+// parallel for/reduce, with scaling from one thread to all cores
+static void example_parallel_scaling() {
+	size_t max_thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+	int64_t base = 0;
+	for (size_t thread_count = 1; ; thread_count = std::min(thread_count * 2, max_thread_count)) {
+		worker_t worker(thread_count);
+		worker.set_work_stealing(true);
+		worker.start();
+
+		std::vector<warp_t> warps;
+		warps.emplace_back(worker);
+		std::atomic<int64_t> elapsed = 0;
+		worker.queue([&worker, &warps, &elapsed]() {
+			example_parallel(worker, &warps[0], 16, elapsed).run();
+		});
+
+		while (!worker.is_terminated()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		worker.join();
+		while (!worker.finalize() || !warp_t::join(warps.begin(), warps.end(), [] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); })) {}
+
+		int64_t us = std::max(elapsed.load(std::memory_order_acquire), int64_t(1));
+		base = base == 0 ? us : base;
+		printf("Parallel reduce: %d threads, %d us, speedup %.2f\n", (int)thread_count, (int)us, (double)base / us);
+
+		if (thread_count == max_thread_count) {
+			break;
+		}
+	}
+}
+
 int main(void) {
 	static constexpr size_t thread_count = 8;
 	static constexpr size_t warp_count = 16;
 
 	iris_async_worker_t<> worker(thread_count);
 	size_t main_thread_index = worker.append(std::thread());
+	worker.set_inline_switch_limit(4);
 	worker.start();
 	pending_count.fetch_add(1, std::memory_order_release);
 
@@ -249,6 +666,15 @@ int main(void) {
 	// finished!
 	while (!worker.finalize() || !warp_t::join(warps.begin(), warps.end(), [] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); })) {}
 
+	example_frame_pool();
+	example_inline_switch();
+	example_timer();
+	example_quota_cancel();
+	example_quota_fair();
+	example_when_all_any();
+	example_parallel_scaling();
+	IRIS_ASSERT(iris_default_frame_pool_t::get_stats().live_count == 0);
+
 	return 0;
 }
 
@@ -14,6 +14,16 @@ static void garbage_collection();
 static void acquire_release();
 static void graph_dispatch();
 static void graph_dispatch_exception();
+static void work_stealing();
+static void thread_parking();
+static void idle_spinning();
+static void inline_function();
+static void batch_queue();
+static void warp_affinity();
+static void active_resize();
+static void yield_notify();
+static void timer_wheel();
+static void simulation();
 
 int main(void) {
 	external_poll();
@@ -25,6 +35,16 @@ int main(void) {
 	acquire_release();
 	graph_dispatch();
 	graph_dispatch_exception();
+	work_stealing();
+	thread_parking();
+	idle_spinning();
+	inline_function();
+	batch_queue();
+	warp_affinity();
+	active_resize();
+	yield_notify();
+	timer_wheel();
+	simulation();
 
 	return 0;
 }
@@ -594,3 +614,577 @@ void acquire_release() {
 	main_warp.join([] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); });
 }
 
+
+void work_stealing() {
+	static constexpr size_t thread_count = 4;
+	static constexpr size_t depth = 12;
+	static constexpr size_t external_count = 256;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+	using warp_t = iris_warp_t<worker_t>;
+
+	printf("[[ demo for iris dispatcher : work_stealing ]] \n");
+
+	worker_t worker(thread_count);
+	worker.set_work_stealing(true);
+	IRIS_ASSERT(worker.is_work_stealing());
+	worker.start();
+
+	warp_t warp(worker);
+	std::atomic<size_t> counter;
+	std::atomic<size_t> warp_counter;
+	counter.store(0, std::memory_order_relaxed);
+	warp_counter.store(0, std::memory_order_relaxed);
+
+	// binary task tree, spawned from worker threads so they go through local deques
+	std::function<void(size_t)> spawn;
+	spawn = [&worker, &warp, &spawn, &counter, &warp_counter](size_t level) {
+		counter.fetch_add(1, std::memory_order_relaxed);
+		if (level != 0) {
+			for (size_t k = 0; k < 2; k++) {
+				worker.queue([&spawn, level]() { spawn(level - 1); }, level % thread_count);
+			}
+		} else {
+			warp.queue_routine_post([&warp, &warp_counter]() {
+				IRIS_ASSERT(warp_t::get_current_warp() == &warp);
+				warp_counter.fetch_add(1, std::memory_order_relaxed);
+			});
+		}
+	};
+
+	worker.queue([&spawn]() { spawn(depth); });
+
+	// tasks from external thread go through shared task heads
+	for (size_t i = 0; i < external_count; i++) {
+		worker.queue([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, i % thread_count);
+	}
+
+	static constexpr size_t expected = (size_t(1) << (depth + 1)) - 1 + external_count;
+	while (counter.load(std::memory_order_acquire) != expected || warp_counter.load(std::memory_order_acquire) != (size_t(1) << depth)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	// all tasks are polled by internal threads, including the ones from external thread
+	uint64_t execute_count = 0;
+	uint64_t steal_count = 0;
+	uint64_t depth_peak = 0;
+	for (size_t i = 0; i < thread_count; i++) {
+		worker_t::thread_stats_t stats = worker.get_thread_stats(i);
+		IRIS_ASSERT(stats.execute_counts.size() == thread_count);
+		for (size_t n = 0; n < stats.execute_counts.size(); n++) {
+			execute_count += stats.execute_counts[n];
+		}
+
+		steal_count += stats.steal_count;
+		depth_peak = std::max(depth_peak, stats.depth_peak);
+		IRIS_ASSERT(stats.wakeup_issued_count <= stats.wakeup_needed_count);
+		printf("[[ thread %d: steal %d, cas retry %d, wakeup %d/%d, running %dus, idle %dus ]]\n", (int)i, (int)stats.steal_count, (int)stats.cas_retry_count,
+			(int)stats.wakeup_issued_count, (int)stats.wakeup_needed_count, (int)(stats.running_time / 1000), (int)(stats.idle_time / 1000));
+	}
+
+	IRIS_ASSERT(execute_count >= expected);
+	IRIS_ASSERT(steal_count <= execute_count);
+	IRIS_ASSERT(depth_peak != 0 && depth_peak <= expected); // tasks are queued by internal threads too
+
+	worker.terminate();
+	worker.join();
+
+	IRIS_ASSERT(counter.load(std::memory_order_acquire) == expected);
+	printf("[[ work_stealing finished: %d tasks ]]\n", (int)expected);
+}
+
+void thread_parking() {
+	static constexpr size_t thread_count = 4;
+	static constexpr size_t round_count = 64;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+
+	printf("[[ demo for iris dispatcher : thread_parking ]] \n");
+
+	iris_parker_t parker;
+	IRIS_ASSERT(!parker.unpark());
+	parker.prepare();
+	IRIS_ASSERT(parker.is_parked());
+	parker.wait_for(std::chrono::milliseconds(1));
+	IRIS_ASSERT(parker.unpark());
+	parker.wait(); // returns immediately since it's unparked
+	IRIS_ASSERT(!parker.cancel());
+
+	worker_t worker(thread_count);
+	worker.start();
+
+	// let all threads fall asleep, then wake them up one task by one task
+	std::atomic<size_t> counter;
+	counter.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < round_count; i++) {
+		if (i % 16 == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+
+		worker.queue([&counter]() {
+			counter.fetch_add(1, std::memory_order_release);
+		});
+	}
+
+	while (counter.load(std::memory_order_acquire) != round_count) {
+		std::this_thread::yield();
+	}
+
+	// targeted wakeup
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	for (size_t i = 0; i < thread_count; i++) {
+		worker.wakeup(i);
+	}
+
+	worker.terminate();
+	worker.join();
+	printf("[[ thread_parking finished ]]\n");
+}
+
+void idle_spinning() {
+	static constexpr size_t thread_count = 2;
+	static constexpr size_t round_count = 256;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+
+	printf("[[ demo for iris dispatcher : idle_spinning ]] \n");
+
+	worker_t worker(thread_count);
+	worker_t::idle_policy_t policy;
+	policy.spin_min = 4;
+	policy.spin_max = 256;
+	policy.yield_count = 1;
+	worker.set_idle_policy(policy);
+	worker.start();
+
+	std::atomic<size_t> counter;
+	counter.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < round_count; i++) {
+		worker.queue([&counter]() {
+			counter.fetch_add(1, std::memory_order_release);
+		});
+
+		if (i % 64 == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	}
+
+	while (counter.load(std::memory_order_acquire) != round_count) {
+		std::this_thread::yield();
+	}
+
+	uint64_t spin_count = 0;
+	for (size_t i = 0; i < thread_count; i++) {
+		worker_t::idle_stats_t stats = worker.get_idle_stats(i);
+		spin_count += stats.spin_hit_count + stats.spin_miss_count;
+		printf("[[ thread %d: spin hit %d, spin miss %d, park %d ]]\n", (int)i, (int)stats.spin_hit_count, (int)stats.spin_miss_count, (int)stats.park_count);
+	}
+
+	worker.terminate();
+	worker.join();
+
+	IRIS_ASSERT(spin_count != 0);
+}
+
+void inline_function() {
+	static constexpr size_t thread_count = 4;
+	static constexpr size_t warp_count = 4;
+	static constexpr size_t round_count = 1024;
+
+	using task_function_t = iris_inline_function_t<64>;
+	using routine_function_t = iris_inline_function_t<48>;
+	using worker_t = iris_async_worker_t<std::thread, task_function_t, worker_allocator_t>;
+	using warp_t = iris_warp_t<worker_t, false, routine_function_t>;
+
+	printf("[[ demo for iris dispatcher : inline_function ]] \n");
+
+	// move only semantics
+	std::shared_ptr<size_t> shared = std::make_shared<size_t>(0);
+	routine_function_t f([shared]() { (*shared)++; });
+	IRIS_ASSERT(f && shared.use_count() == 2);
+	routine_function_t g(std::move(f));
+	IRIS_ASSERT(!f && g);
+	g();
+	f = std::move(g);
+	f();
+	IRIS_ASSERT(*shared == 2);
+	f = nullptr;
+	IRIS_ASSERT(!f && shared.use_count() == 1);
+
+	// static_assert fails if uncommented:
+	// char large[64] = {};
+	// routine_function_t h([large]() {});
+
+	worker_t worker(thread_count);
+	worker.start();
+
+	std::vector<warp_t> warps;
+	warps.reserve(warp_count);
+	for (size_t i = 0; i < warp_count; i++) {
+		warps.emplace_back(worker);
+	}
+
+	std::atomic<size_t> counter;
+	counter.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < round_count; i++) {
+		warps[i % warp_count].queue_routine_external([&counter, &warps, shared, i]() {
+			warps[(i + 1) % warp_count].queue_routine_post([&counter, shared]() {
+				counter.fetch_add(1, std::memory_order_release);
+			});
+		});
+	}
+
+	while (counter.load(std::memory_order_acquire) != round_count) {
+		std::this_thread::yield();
+	}
+
+	worker.terminate();
+	worker.join();
+
+	while (!worker.finalize() || !warp_t::join(warps.begin(), warps.end(), [] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); })) {}
+
+	IRIS_ASSERT(shared.use_count() == 1);
+}
+
+void batch_queue() {
+	static constexpr size_t thread_count = 4;
+	static constexpr size_t batch_size = 64;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+	using warp_t = iris_warp_t<worker_t>;
+	using strand_warp_t = iris_warp_t<worker_t, true>;
+
+	printf("[[ demo for iris dispatcher : batch_queue ]] \n");
+
+	for (size_t mode = 0; mode < 2; mode++) {
+		worker_t worker(thread_count);
+		worker.set_work_stealing(mode != 0);
+		worker.start();
+
+		warp_t warp(worker);
+		strand_warp_t strand_warp(worker);
+		std::atomic<size_t> counter;
+		counter.store(0, std::memory_order_relaxed);
+		std::vector<size_t> warp_order;
+		std::vector<size_t> strand_order;
+
+		// from external thread
+		std::vector<std::function<void()>> tasks;
+		for (size_t i = 0; i < batch_size; i++) {
+			tasks.emplace_back([&counter]() { counter.fetch_add(1, std::memory_order_release); });
+		}
+
+		worker.queue_batch(tasks.begin(), tasks.end(), 1);
+
+		// from worker thread
+		worker.queue([&]() {
+			std::vector<std::function<void()>> local_tasks;
+			std::vector<std::function<void()>> routines;
+			std::vector<std::function<void()>> strand_routines;
+			for (size_t i = 0; i < batch_size; i++) {
+				local_tasks.emplace_back([&counter]() { counter.fetch_add(1, std::memory_order_release); });
+				routines.emplace_back([&counter, &warp_order, i]() { warp_order.emplace_back(i); counter.fetch_add(1, std::memory_order_release); });
+				strand_routines.emplace_back([&counter, &strand_order, i]() { strand_order.emplace_back(i); counter.fetch_add(1, std::memory_order_release); });
+			}
+
+			worker.queue_batch(local_tasks.begin(), local_tasks.end());
+			warp.queue_routine_batch(routines.begin(), routines.end());
+			strand_warp.queue_routine_batch(strand_routines.begin(), strand_routines.end());
+		});
+
+		while (counter.load(std::memory_order_acquire) != batch_size * 4) {
+			std::this_thread::yield();
+		}
+
+		worker.terminate();
+		worker.join();
+
+		IRIS_ASSERT(warp_order.size() == batch_size && strand_order.size() == batch_size);
+		for (size_t i = 0; i < batch_size; i++) {
+			IRIS_ASSERT(warp_order[i] == i);
+			IRIS_ASSERT(strand_order[i] == i);
+		}
+	}
+}
+
+void warp_affinity() {
+	static constexpr size_t thread_count = 4;
+	static constexpr size_t round_count = 256;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+	using warp_t = iris_warp_t<worker_t>;
+
+	printf("[[ demo for iris dispatcher : warp_affinity ]] \n");
+
+	for (size_t mode = 0; mode < 2; mode++) {
+		worker_t worker(thread_count);
+		worker.set_work_stealing(mode != 0);
+		worker.start();
+
+		warp_t warp(worker);
+		warp.set_affinity(2);
+		IRIS_ASSERT(warp.get_affinity() == 2);
+
+		std::atomic<size_t> counter;
+		counter.store(0, std::memory_order_relaxed);
+		std::atomic<size_t> preferred_count;
+		preferred_count.store(0, std::memory_order_relaxed);
+
+		for (size_t i = 0; i < round_count; i++) {
+			// from both external and worker threads
+			auto routine = [&]() {
+				if (worker_t::get_current_thread_index() == 2) {
+					preferred_count.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				counter.fetch_add(1, std::memory_order_release);
+			};
+
+			if (i & 1) {
+				worker.queue([&warp, routine]() { warp.queue_routine_post(routine); });
+			} else {
+				warp.queue_routine_external(routine);
+			}
+
+			if ((i & 15) == 0) {
+				// make sure the warp is idle so next routine must be scheduled again
+				while (counter.load(std::memory_order_acquire) != i + 1) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		while (counter.load(std::memory_order_acquire) != round_count) {
+			std::this_thread::yield();
+		}
+
+		worker.terminate();
+		worker.join();
+
+		warp_t::affinity_stats_t stats = warp.get_affinity_stats();
+		printf("Affinity: execute %d, migration %d, hit %d, preferred %d\n", (int)stats.execute_count, (int)stats.migration_count, (int)stats.affinity_hit_count, (int)preferred_count.load(std::memory_order_relaxed));
+		IRIS_ASSERT(stats.execute_count != 0);
+		IRIS_ASSERT(stats.affinity_hit_count <= stats.execute_count);
+		IRIS_ASSERT(stats.migration_count < stats.execute_count);
+
+		warp_t::run_stats_t run_stats = warp.get_run_stats();
+		IRIS_ASSERT(run_stats.execute_count == stats.execute_count);
+		IRIS_ASSERT(run_stats.routine_count == round_count);
+		IRIS_ASSERT(run_stats.run_time != 0);
+	}
+}
+
+void active_resize() {
+	static constexpr size_t thread_count = 4;
+	static constexpr size_t task_count = 256;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+	using warp_t = iris_warp_t<worker_t>;
+
+	printf("[[ demo for iris dispatcher : active_resize ]] \n");
+
+	for (size_t mode = 0; mode < 2; mode++) {
+		worker_t worker(thread_count);
+		worker.set_work_stealing(mode != 0);
+		worker.start();
+		IRIS_ASSERT(worker.get_active_count() == thread_count);
+
+		warp_t warp(worker);
+		warp.set_affinity(thread_count - 1); // retired later, must fall back to other threads
+
+		std::atomic<size_t> counter;
+		std::atomic<size_t> retired_count;
+		for (size_t round = 0; round < 3; round++) {
+			size_t active = round == 1 ? 1 : thread_count;
+			worker.set_active_count(active);
+			IRIS_ASSERT(worker.get_active_count() == active);
+			counter.store(0, std::memory_order_relaxed);
+			retired_count.store(0, std::memory_order_relaxed);
+
+			auto task = [&worker, &counter, &retired_count]() {
+				if (worker.is_retired(worker_t::get_current_thread_index())) {
+					retired_count.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				counter.fetch_add(1, std::memory_order_release);
+			};
+
+			for (size_t i = 0; i < task_count; i++) {
+				if (i & 1) {
+					worker.queue(task);
+				} else {
+					warp.queue_routine_external(task);
+				}
+			}
+
+			while (counter.load(std::memory_order_acquire) != task_count) {
+				std::this_thread::yield();
+			}
+
+			// threads that were already polling when retired may finish one more task
+			printf("Active %d: retired executions %d\n", (int)active, (int)retired_count.load(std::memory_order_relaxed));
+			IRIS_ASSERT(retired_count.load(std::memory_order_relaxed) < thread_count);
+		}
+
+		worker.terminate();
+		worker.join();
+	}
+}
+
+void yield_notify() {
+	static constexpr size_t thread_count = 2;
+	static constexpr size_t round_count = 16;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+	using warp_t = iris_warp_t<worker_t>;
+
+	printf("[[ demo for iris dispatcher : yield_notify ]] \n");
+
+	worker_t worker(thread_count);
+	worker.start();
+	warp_t warp(worker);
+
+	std::atomic<size_t> counter;
+	counter.store(0, std::memory_order_relaxed);
+	std::atomic<bool> entered;
+	auto begin = std::chrono::steady_clock::now();
+
+	for (size_t round = 0; round < round_count; round++) {
+		entered.store(false, std::memory_order_relaxed);
+		warp.queue_routine_external([&counter, &entered]() {
+			entered.store(true, std::memory_order_release);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			counter.fetch_add(1, std::memory_order_relaxed);
+		});
+
+		while (!entered.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+
+		// the timeout is much longer than the task, we must be waked up by yield()
+		while (!warp.join([&warp]() { warp.wait_yield(std::chrono::seconds(1)); })) {}
+		IRIS_ASSERT(counter.load(std::memory_order_relaxed) == round + 1);
+	}
+
+	int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+	printf("Synchronized %d rounds in %d ms\n", (int)round_count, (int)ms);
+	IRIS_ASSERT(ms < 1000);
+
+	worker.terminate();
+	worker.join();
+}
+
+void timer_wheel() {
+	printf("[[ demo for iris dispatcher : timer_wheel ]] \n");
+
+	// each element records its own expiration tick
+	iris_timer_wheel_t<uint64_t> wheel(1000);
+	std::vector<uint64_t> ticks = { 1001, 1002, 1255, 1256, 1257, 1300, 2000, 1000 + 256 * 64, 1000 + 256 * 64 + 1, 1000 + 256 * 64 * 64 * 64 + 7, 5 };
+	uint32_t seed = 1;
+	for (size_t i = 0; i < 256; i++) {
+		seed = seed * 1103515245u + 12345u;
+		ticks.emplace_back(1000 + (seed >> 8) % (256 * 64 * 16));
+	}
+
+	for (uint64_t tick : ticks) {
+		wheel.push(tick, uint64_t(tick));
+	}
+
+	IRIS_ASSERT(wheel.size() == ticks.size());
+	size_t expired = 0;
+	uint64_t last = ~uint64_t(0);
+	while (wheel.size() != 0) {
+		uint64_t next = wheel.get_next_tick();
+		IRIS_ASSERT(next > wheel.get_current_tick());
+		// jump forward in varying steps, all expired elements must be due and none missed before next
+		uint64_t target = (expired & 1) ? next : next + 3;
+		wheel.advance(target, [&](uint64_t&& tick) {
+			IRIS_ASSERT(std::max(tick, (uint64_t)1001) <= target);
+			IRIS_ASSERT(std::max(tick, (uint64_t)1001) >= next);
+			last = tick;
+			expired++;
+		});
+	}
+
+	IRIS_ASSERT(expired == ticks.size());
+	IRIS_ASSERT(last == 1000 + 256 * 64 * 64 * 64 + 7);
+	printf("Timer wheel expired %d timers\n", (int)expired);
+}
+
+void simulation() {
+	static constexpr size_t thread_count = 4;
+	static constexpr size_t chain_count = 16;
+	static constexpr size_t chain_length = 8;
+
+	using worker_t = iris_async_worker_t<std::thread, std::function<void()>, worker_allocator_t>;
+	using warp_t = iris_warp_t<worker_t>;
+
+	printf("[[ demo for iris dispatcher : simulation ]] \n");
+
+	// returns the order of executed steps, encoded as chain * chain_length + step
+	auto run = [](uint64_t seed, worker_t::simulation_stats_t& stats) {
+		worker_t worker(thread_count);
+		worker.set_simulation(true, seed);
+		worker.start();
+		IRIS_ASSERT(worker.is_simulation());
+
+		warp_t warp(worker);
+		std::vector<size_t> order;
+		std::atomic<size_t> finished;
+		finished.store(0, std::memory_order_relaxed);
+		std::function<void(size_t, size_t)> step = [&](size_t chain, size_t index) {
+			// all tasks run on the driving thread, so no locking for order
+			order.emplace_back(chain * chain_length + index);
+			IRIS_ASSERT(worker_t::get_current_thread_index() < thread_count);
+			if (index + 1 < chain_length) {
+				if (index & 1) {
+					warp.queue_routine_post([&step, chain, index]() { step(chain, index + 1); });
+				} else {
+					worker.queue([&step, chain, index]() { step(chain, index + 1); });
+				}
+			} else {
+				finished.fetch_add(1, std::memory_order_relaxed);
+			}
+		};
+
+		for (size_t i = 0; i < chain_count; i++) {
+			worker.queue([&step, i]() { step(i, 0); });
+		}
+
+		// one hour in virtual time
+		bool expired = false;
+		worker.queue_timer([&expired]() { expired = true; }, std::chrono::hours(1));
+
+		auto start = std::chrono::steady_clock::now();
+		while (finished.load(std::memory_order_relaxed) != chain_count || !expired) {
+			worker.poll_delay(0, std::chrono::milliseconds(20));
+		}
+
+		IRIS_ASSERT(std::chrono::steady_clock::now() - start < std::chrono::minutes(1));
+		stats = worker.get_simulation_stats();
+		worker.terminate();
+		worker.join();
+		return order;
+	};
+
+	worker_t::simulation_stats_t stats;
+	std::vector<size_t> first = run(1, stats);
+	IRIS_ASSERT(first.size() == chain_count * chain_length);
+	IRIS_ASSERT(stats.seed == 1);
+	printf("Simulation: tasks %d, critical path %d, virtual time %d s\n", (int)stats.task_count, (int)stats.critical_path, (int)(stats.virtual_time / 1000000000u));
+	// routines posted to the warp may be batched into one task
+	IRIS_ASSERT(stats.critical_path >= chain_length / 2);
+	IRIS_ASSERT(stats.task_count > chain_count * chain_length / 2);
+	IRIS_ASSERT(stats.virtual_time >= 3600ull * 1000000000ull);
+	IRIS_ASSERT(stats.pending_count == 0);
+
+	// replayed exactly with the same seed
+	worker_t::simulation_stats_t replay_stats;
+	std::vector<size_t> replay = run(1, replay_stats);
+	IRIS_ASSERT(replay == first);
+	IRIS_ASSERT(replay_stats.task_count == stats.task_count && replay_stats.critical_path == stats.critical_path && replay_stats.virtual_time == stats.virtual_time);
+
+	worker_t::simulation_stats_t other_stats;
+	std::vector<size_t> other = run(2, other_stats);
+	IRIS_ASSERT(other.size() == first.size() && other != first);
+}
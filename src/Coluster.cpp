@@ -6,10 +6,30 @@
 #include <uuid/uuid.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#endif
+
+#include <algorithm>
+#include <bit>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 namespace iris {
 	implement_shared_static_instance(coluster::Warp::Base*);
 	implement_shared_static_instance(coluster::AsyncWorker::thread_index_t);
+	implement_shared_static_instance(iris::iris_arena_index_t);
 	implement_shared_static_instance(coluster::RootAlloator);
+	implement_shared_static_instance(iris::iris_default_frame_pool_t::global_t);
+	implement_shared_static_instance(iris::iris_default_frame_pool_t::thread_cache_t);
 }
 
 namespace coluster {
@@ -26,26 +46,614 @@ namespace coluster {
 		return CurrentCoroutineAddress;
 	}
 
-	AsyncWorker::AsyncWorker() : memoryQuota({ DEFAULT_HOST_MEMORY_BUDGET, DEFAULT_DEVICE_MEMORY_BUDGET }), memoryQuotaQueue(*this, memoryQuota) {}
+	static constexpr size_t CoroutineGenerationCount = 4096;
+	static std::atomic<uint64_t> CoroutineGenerations[CoroutineGenerationCount] = {};
+
+	static std::atomic<uint64_t>& GetCoroutineGenerationSlot(void* address) noexcept {
+		// frames are at least 16 bytes aligned
+		return CoroutineGenerations[(reinterpret_cast<size_t>(address) >> 4) % CoroutineGenerationCount];
+	}
+
+	// generations are only compared with chain records, which are discarded on reenabling chain sampling, see Warp::SetChainSampling()
+	void BeginCoroutineAddress(void* address) noexcept {
+		if (Warp::GetChainSampling() != 0) {
+			GetCoroutineGenerationSlot(address).fetch_add(1, std::memory_order_relaxed);
+		}
+
+		SetCurrentCoroutineAddress(address);
+	}
+
+	uint64_t GetCoroutineGeneration(void* address) noexcept {
+		return GetCoroutineGenerationSlot(address).load(std::memory_order_relaxed);
+	}
+
+	// single producer ring of trace events, the producer drops new events if it's full
+	struct TraceBuffer {
+		static constexpr size_t capacity = 1 << 16;
+		explicit TraceBuffer(uint32_t id) : events(new TraceEvent[capacity]), thread(id) {}
+
+		std::unique_ptr<TraceEvent[]> events;
+		std::atomic<size_t> writeIndex = 0;
+		std::atomic<size_t> readIndex = 0; // written by the collector with traceLock held
+		std::atomic<uint64_t> droppedCount = 0;
+		uint32_t thread;
+		std::string name; // guarded by traceLock
+	};
+
+	static uint64_t GetTraceNanoseconds() noexcept {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// raw timestamps are converted to nanoseconds on collection, reading tsc is much cheaper than steady_clock
+	static uint64_t GetTraceTicks() noexcept {
+#if defined(_M_X64) || defined(__x86_64__)
+		return __rdtsc();
+#else
+		return GetTraceNanoseconds();
+#endif
+	}
+
+	static std::atomic<bool> TraceEnabled = false;
+	static uint64_t TraceBaseTicks = 0; // guarded by TraceLock
+	static uint64_t TraceBaseNanoseconds = 0;
+	static std::mutex TraceLock;
+	static std::vector<std::unique_ptr<TraceBuffer>> TraceBuffers; // never shrinks, rings are owned by threads with thread_local pointers
+	static thread_local TraceBuffer* CurrentTraceBuffer = nullptr;
+	static thread_local std::string CurrentTraceThreadName;
+
+	static TraceBuffer* GetTraceBuffer() {
+		TraceBuffer* buffer = CurrentTraceBuffer;
+		if (buffer == nullptr) {
+			std::lock_guard<std::mutex> guard(TraceLock);
+			TraceBuffers.emplace_back(std::make_unique<TraceBuffer>(static_cast<uint32_t>(TraceBuffers.size())));
+			buffer = CurrentTraceBuffer = TraceBuffers.back().get();
+			buffer->name = CurrentTraceThreadName.empty() ? "thread " + std::to_string(buffer->thread) : CurrentTraceThreadName;
+		}
+
+		return buffer;
+	}
+
+	static void RecordTrace(const char* name, char phase) noexcept {
+		TraceBuffer* buffer = GetTraceBuffer();
+		size_t writeIndex = buffer->writeIndex.load(std::memory_order_relaxed);
+		if (writeIndex - buffer->readIndex.load(std::memory_order_acquire) >= TraceBuffer::capacity) {
+			buffer->droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		TraceEvent& event = buffer->events[writeIndex & (TraceBuffer::capacity - 1)];
+		event.timestamp = GetTraceTicks();
+		event.name = name;
+		event.warp = Warp::get_current_warp();
+		event.phase = phase;
+		buffer->writeIndex.store(writeIndex + 1, std::memory_order_release);
+	}
+
+	bool TraceBegin(const char* name) noexcept {
+		if (TraceEnabled.load(std::memory_order_relaxed)) {
+			RecordTrace(name, 'B');
+			return true;
+		} else {
+			return false;
+		}
+	}
+
+	void TraceEnd(bool force) noexcept {
+		if (force || TraceEnabled.load(std::memory_order_relaxed)) {
+			RecordTrace(nullptr, 'E');
+		}
+	}
+
+	void TraceInstant(const char* name) noexcept {
+		if (TraceEnabled.load(std::memory_order_relaxed)) {
+			RecordTrace(name, 'i');
+		}
+	}
+
+	void TraceThread(const char* name, size_t index) noexcept {
+		CurrentTraceThreadName = std::string(name) + " " + std::to_string(index);
+		if (CurrentTraceBuffer != nullptr) {
+			std::lock_guard<std::mutex> guard(TraceLock);
+			CurrentTraceBuffer->name = CurrentTraceThreadName;
+		}
+	}
+
+	void EnableTrace(bool enable) noexcept {
+		std::lock_guard<std::mutex> guard(TraceLock);
+		if (enable && !TraceEnabled.load(std::memory_order_relaxed)) {
+			TraceBaseTicks = GetTraceTicks();
+			TraceBaseNanoseconds = GetTraceNanoseconds();
+			for (auto& buffer : TraceBuffers) {
+				buffer->readIndex.store(buffer->writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+				buffer->droppedCount.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		TraceEnabled.store(enable, std::memory_order_release);
+	}
+
+	bool IsTraceEnabled() noexcept {
+		return TraceEnabled.load(std::memory_order_acquire);
+	}
+
+	uint64_t CollectTrace(std::vector<TraceThreadEvents>& threads) {
+		std::lock_guard<std::mutex> guard(TraceLock);
+		// calibrate ticks against steady clock over the whole tracing period
+		uint64_t elapsedTicks = GetTraceTicks() - TraceBaseTicks;
+		uint64_t elapsedNanoseconds = GetTraceNanoseconds() - TraceBaseNanoseconds;
+		double scale = elapsedTicks == 0 ? 1.0 : static_cast<double>(elapsedNanoseconds) / static_cast<double>(elapsedTicks);
+
+		uint64_t droppedCount = 0;
+		for (auto& buffer : TraceBuffers) {
+			size_t readIndex = buffer->readIndex.load(std::memory_order_relaxed);
+			size_t writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+			droppedCount += buffer->droppedCount.exchange(0, std::memory_order_relaxed);
+
+			if (readIndex != writeIndex) {
+				TraceThreadEvents& target = threads.emplace_back();
+				target.thread = buffer->thread;
+				target.name = buffer->name;
+				target.events.reserve(writeIndex - readIndex);
+				for (size_t i = readIndex; i != writeIndex; i++) {
+					TraceEvent& event = target.events.emplace_back(buffer->events[i & (TraceBuffer::capacity - 1)]);
+					int64_t ticks = static_cast<int64_t>(event.timestamp - TraceBaseTicks);
+					event.timestamp = TraceBaseNanoseconds + static_cast<uint64_t>(std::max(static_cast<double>(ticks) * scale, 0.0));
+				}
+
+				buffer->readIndex.store(writeIndex, std::memory_order_release);
+			}
+		}
+
+		return droppedCount;
+	}
+
+	// log-bucketed like HdrHistogram: values below subBucketCount are exact, larger ones keep the highest subBucketBits + 1 bits
+	struct LatencyHistogram {
+		static constexpr size_t subBucketBits = 4;
+		static constexpr size_t subBucketCount = size_t(1) << subBucketBits;
+		static constexpr size_t bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+		static constexpr size_t typeCount = static_cast<size_t>(LatencyType::Count);
+
+		static size_t GetBucket(uint64_t value) noexcept {
+			if (value < subBucketCount) {
+				return static_cast<size_t>(value);
+			}
+
+			size_t exponent = static_cast<size_t>(std::bit_width(value)) - 1;
+			return (exponent - subBucketBits + 1) * subBucketCount + static_cast<size_t>((value >> (exponent - subBucketBits)) & (subBucketCount - 1));
+		}
+
+		static uint64_t GetBucketUpperBound(size_t bucket) noexcept {
+			if (bucket < subBucketCount) {
+				return bucket;
+			}
+
+			size_t shift = bucket / subBucketCount - 1;
+			uint64_t lower = static_cast<uint64_t>(subBucketCount + bucket % subBucketCount) << shift;
+			return lower + ((uint64_t(1) << shift) - 1);
+		}
+
+		// single writer, so no read-modify-write operations required
+		void Add(LatencyType type, uint64_t ticks) noexcept {
+			size_t index = static_cast<size_t>(type);
+			std::atomic<uint64_t>& bucket = buckets[index * bucketCount + GetBucket(ticks)];
+			bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			sums[index].store(sums[index].load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+		}
+
+		std::atomic<uint64_t> buckets[typeCount * bucketCount];
+		std::atomic<uint64_t> sums[typeCount];
+	};
+
+	static const uint64_t LatencyBaseTicks = GetTraceTicks();
+	static const uint64_t LatencyBaseNanoseconds = GetTraceNanoseconds();
+	static std::mutex LatencyLock;
+	static std::vector<std::unique_ptr<LatencyHistogram>> LatencyHistograms; // never shrinks like TraceBuffers
+	static std::vector<uint64_t> LatencyBaselineBuckets; // totals on the last reset, guarded by LatencyLock
+	static std::vector<uint64_t> LatencyBaselineSums;
+	static thread_local LatencyHistogram* CurrentLatencyHistogram = nullptr;
+
+	uint64_t GetLatencyTicks() noexcept {
+		return GetTraceTicks();
+	}
+
+	void RecordLatency(LatencyType type, uint64_t startTicks) noexcept {
+		uint64_t ticks = 0;
+		if (startTicks != 0) {
+			uint64_t now = GetTraceTicks();
+			ticks = now > startTicks ? now - startTicks : 0; // tsc of different cores may be slightly skewed
+		}
+
+		LatencyHistogram* histogram = CurrentLatencyHistogram;
+		if (histogram == nullptr) {
+			std::lock_guard<std::mutex> guard(LatencyLock);
+			LatencyHistograms.emplace_back(std::make_unique<LatencyHistogram>());
+			histogram = CurrentLatencyHistogram = LatencyHistograms.back().get();
+		}
+
+		histogram->Add(type, ticks);
+	}
+
+	LatencyStats GetLatencyStats(LatencyType type) {
+		std::lock_guard<std::mutex> guard(LatencyLock);
+		size_t index = static_cast<size_t>(type);
+		std::vector<uint64_t> buckets(LatencyHistogram::bucketCount);
+		uint64_t sum = LatencyBaselineSums.empty() ? 0 : (0 - LatencyBaselineSums[index]);
+		for (auto& histogram : LatencyHistograms) {
+			for (size_t i = 0; i < LatencyHistogram::bucketCount; i++) {
+				buckets[i] += histogram->buckets[index * LatencyHistogram::bucketCount + i].load(std::memory_order_relaxed);
+			}
+
+			sum += histogram->sums[index].load(std::memory_order_relaxed);
+		}
+
+		LatencyStats stats;
+		for (size_t i = 0; i < LatencyHistogram::bucketCount; i++) {
+			if (!LatencyBaselineBuckets.empty()) {
+				buckets[i] -= std::min(buckets[i], LatencyBaselineBuckets[index * LatencyHistogram::bucketCount + i]);
+			}
+
+			stats.count += buckets[i];
+		}
+
+		if (stats.count != 0) {
+			// calibrate ticks against steady clock over the whole process lifetime
+			uint64_t elapsedTicks = GetTraceTicks() - LatencyBaseTicks;
+			uint64_t elapsedNanoseconds = GetTraceNanoseconds() - LatencyBaseNanoseconds;
+			double scale = elapsedTicks == 0 ? 1.0 : static_cast<double>(elapsedNanoseconds) / static_cast<double>(elapsedTicks);
+			auto convert = [scale](uint64_t ticks) { return static_cast<uint64_t>(static_cast<double>(ticks) * scale); };
+
+			stats.mean = convert(sum / stats.count);
+			std::pair<uint64_t*, uint64_t> percentiles[] = { { &stats.p50, 500 }, { &stats.p90, 900 }, { &stats.p99, 990 }, { &stats.p999, 999 } };
+			size_t next = 0;
+			uint64_t accumulated = 0;
+			for (size_t i = 0; i < LatencyHistogram::bucketCount; i++) {
+				if (buckets[i] != 0) {
+					accumulated += buckets[i];
+					stats.max = convert(LatencyHistogram::GetBucketUpperBound(i));
+					while (next < std::size(percentiles) && accumulated * 1000 >= stats.count * percentiles[next].second) { // nearest rank
+						*percentiles[next++].first = stats.max;
+					}
+				}
+			}
+		}
+
+		return stats;
+	}
+
+	void ResetLatencyStats() {
+		std::lock_guard<std::mutex> guard(LatencyLock);
+		LatencyBaselineBuckets.assign(LatencyHistogram::typeCount * LatencyHistogram::bucketCount, 0);
+		LatencyBaselineSums.assign(LatencyHistogram::typeCount, 0);
+		for (auto& histogram : LatencyHistograms) {
+			for (size_t i = 0; i < LatencyBaselineBuckets.size(); i++) {
+				LatencyBaselineBuckets[i] += histogram->buckets[i].load(std::memory_order_relaxed);
+			}
+
+			for (size_t i = 0; i < LatencyBaselineSums.size(); i++) {
+				LatencyBaselineSums[i] += histogram->sums[i].load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	const char* GetLatencyTypeName(LatencyType type) noexcept {
+		static const char* names[] = { "HostQuota", "DeviceQuota", "FileIO", "DeviceSubmit", "WarpSwitch", "PipePop" };
+		static_assert(std::size(names) == static_cast<size_t>(LatencyType::Count), "Latency type names mismatch!");
+		return names[static_cast<size_t>(type)];
+	}
+
+	AsyncWorker::AsyncWorker() : memoryBudget({ DEFAULT_HOST_MEMORY_BUDGET, DEFAULT_DEVICE_MEMORY_BUDGET }), memoryQuota(memoryBudget), memoryQuotaQueue(*this, memoryQuota, static_cast<size_t>(MemoryCategory::Count)) {}
 	AsyncWorker::MemoryQuotaQueue& AsyncWorker::GetMemoryQuotaQueue() noexcept {
 		return memoryQuotaQueue;
 	}
 
+	void AsyncWorker::SetMemoryBudget(const MemoryQuota::amount_t& budget) {
+		MemoryQuota::amount_t raised = {};
+		MemoryQuota::amount_t lowered = {};
+		do {
+			std::lock_guard<std::mutex> guard(memoryBudgetLock);
+			for (size_t i = 0; i < budget.size(); i++) {
+				if (budget[i] > memoryBudget[i]) {
+					raised[i] = budget[i] - memoryBudget[i];
+				} else {
+					lowered[i] = memoryBudget[i] - budget[i];
+				}
+			}
+
+			memoryBudget = budget;
+		} while (false);
+
+		// lower first, so the raised part is never granted twice
+		memoryQuotaQueue.lower(lowered);
+		memoryQuotaQueue.raise(raised);
+	}
+
+	AsyncWorker::MemoryQuota::amount_t AsyncWorker::GetMemoryBudget() const noexcept {
+		std::lock_guard<std::mutex> guard(memoryBudgetLock);
+		return memoryBudget;
+	}
+
+	AsyncWorker::MemoryQuota::amount_t AsyncWorker::GetMemoryUsage(MemoryCategory category) const noexcept {
+		return memoryQuotaQueue.get_usage(static_cast<size_t>(category));
+	}
+
+#ifdef __linux__
+	// returns ~0 for "max" or missing files
+	static size_t ReadMemoryValue(const std::string& path) {
+		std::ifstream file(path);
+		std::string line;
+		if (!file || !std::getline(file, line) || line.empty() || line == "max") {
+			return ~(size_t)0;
+		}
+
+		return static_cast<size_t>(std::strtoull(line.c_str(), nullptr, 10));
+	}
+#endif
+
+	size_t AsyncWorker::DetectHostMemoryBudget() {
+		size_t available = 0;
+#ifdef _WIN32
+		MEMORYSTATUSEX status;
+		status.dwLength = sizeof(status);
+		if (::GlobalMemoryStatusEx(&status)) {
+			available = static_cast<size_t>(status.ullAvailPhys);
+		}
+#elif defined(__linux__)
+		std::ifstream meminfo("/proc/meminfo");
+		std::string line;
+		while (std::getline(meminfo, line)) {
+			if (line.compare(0, 13, "MemAvailable:") == 0) {
+				available = static_cast<size_t>(std::strtoull(line.c_str() + 13, nullptr, 10)) * 1024;
+				break;
+			}
+		}
+
+		// cgroup v2 only has the unified "0::<path>" entry
+		std::ifstream cgroup("/proc/self/cgroup");
+		while (std::getline(cgroup, line)) {
+			if (line.compare(0, 3, "0::") == 0) {
+				std::string path = "/sys/fs/cgroup" + line.substr(3);
+				size_t current = ReadMemoryValue(path + "/memory.current");
+
+				// the tightest limit along ancestors applies
+				size_t limit = ~(size_t)0;
+				while (true) {
+					limit = std::min(limit, ReadMemoryValue(path + "/memory.max"));
+					size_t pos = path.find_last_of('/');
+					if (pos == std::string::npos || path.size() <= sizeof("/sys/fs/cgroup") - 1) {
+						break;
+					}
+
+					path.resize(pos);
+				}
+
+				if (limit != ~(size_t)0) {
+					size_t remaining = current == ~(size_t)0 ? limit : (limit > current ? limit - current : 0);
+					available = available == 0 ? remaining : std::min(available, remaining);
+				}
+
+				break;
+			}
+		}
+#endif
+
+		return available / 2;
+	}
+
 	void AsyncWorker::SetupSharedWarps(size_t count) {
 		sharedWarps.resize(count);
 		for (size_t i = 0; i < count; i++) {
 			sharedWarps[i] = std::make_shared<Warp>(*this);
 		}
+
+		// spread shared warps (and AsyncMap shards on them) across NUMA nodes
+		if (!threadNodes.empty()) {
+			std::vector<size_t> order;
+			order.reserve(threadNodes.size());
+			for (size_t k = 0; order.size() < threadNodes.size(); k++) {
+				for (size_t node = 0; node < nodeCount; node++) {
+					size_t n = 0;
+					for (size_t i = 0; i < threadNodes.size(); i++) {
+						if (threadNodes[i] == node && n++ == k) {
+							order.emplace_back(i);
+							break;
+						}
+					}
+				}
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				sharedWarps[i]->set_affinity(order[i % order.size()]);
+			}
+		}
+	}
+
+	static std::vector<size_t> ParseCpuList(const std::string& text) {
+		// format: 0-3,8,10-11
+		std::vector<size_t> cpus;
+		size_t i = 0;
+		while (i < text.size()) {
+			size_t end = text.find(',', i);
+			std::string item = text.substr(i, end == std::string::npos ? std::string::npos : end - i);
+			size_t dash = item.find('-');
+			if (!item.empty() && item[0] >= '0' && item[0] <= '9') {
+				size_t from = std::stoul(item);
+				size_t to = dash == std::string::npos ? from : std::stoul(item.substr(dash + 1));
+				for (size_t cpu = from; cpu <= to; cpu++) {
+					cpus.emplace_back(cpu);
+				}
+			}
+
+			if (end == std::string::npos)
+				break;
+
+			i = end + 1;
+		}
+
+		return cpus;
+	}
+
+	std::vector<std::vector<size_t>> AsyncWorker::DetectTopology() {
+		std::vector<std::vector<size_t>> nodes;
+#ifdef _WIN32
+		ULONG highest = 0;
+		if (::GetNumaHighestNodeNumber(&highest)) {
+			for (ULONG node = 0; node <= highest; node++) {
+				ULONGLONG mask = 0;
+				if (::GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask) && mask != 0) {
+					std::vector<size_t> cpus;
+					for (size_t cpu = 0; cpu < sizeof(mask) * 8; cpu++) {
+						if (mask & (ULONGLONG(1) << cpu)) {
+							cpus.emplace_back(cpu);
+						}
+					}
+
+					nodes.emplace_back(std::move(cpus));
+				}
+			}
+		}
+#elif defined(__linux__)
+		for (size_t node = 0; ; node++) {
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			if (!file)
+				break;
+
+			std::string line;
+			std::getline(file, line);
+			std::vector<size_t> cpus = ParseCpuList(line);
+			if (!cpus.empty()) { // skip memory-only nodes
+				nodes.emplace_back(std::move(cpus));
+			}
+		}
+#endif
+
+		if (nodes.empty()) {
+			std::vector<size_t> cpus(std::max(std::thread::hardware_concurrency(), 1u));
+			for (size_t cpu = 0; cpu < cpus.size(); cpu++) {
+				cpus[cpu] = cpu;
+			}
+
+			nodes.emplace_back(std::move(cpus));
+		}
+
+		return nodes;
+	}
+
+	size_t AsyncWorker::GetThreadNode(size_t threadIndex) const noexcept {
+		return threadIndex < threadNodes.size() ? threadNodes[threadIndex] : 0;
+	}
+
+	static void PinCurrentThread(const std::vector<size_t>& cpus) noexcept {
+#ifdef _WIN32
+		DWORD_PTR mask = 0;
+		for (size_t cpu : cpus) {
+			if (cpu < sizeof(mask) * 8) {
+				mask |= DWORD_PTR(1) << cpu;
+			}
+		}
+
+		if (mask != 0) {
+			::SetThreadAffinityMask(::GetCurrentThread(), mask);
+		}
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (size_t cpu : cpus) {
+			if (cpu < CPU_SETSIZE) {
+				CPU_SET(cpu, &set);
+			}
+		}
+
+		if (CPU_COUNT(&set) != 0) {
+			::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+		}
+#endif
+	}
+
+	void AsyncWorker::SetupAffinity(ThreadAffinity affinity, std::vector<size_t>&& cpus) {
+		threadCpus.clear();
+		threadNodes.clear();
+		nodeCount = 1;
+
+		if (affinity == ThreadAffinity::None) {
+			set_thread_initializer(std::function<void(size_t)>());
+			return;
+		}
+
+		std::vector<std::vector<size_t>> nodes = DetectTopology();
+		auto findNode = [&nodes](size_t cpu) {
+			for (size_t node = 0; node < nodes.size(); node++) {
+				if (std::find(nodes[node].begin(), nodes[node].end(), cpu) != nodes[node].end()) {
+					return node;
+				}
+			}
+
+			return size_t(0);
+		};
+
+		size_t count = get_thread_count();
+		threadCpus.resize(count);
+		threadNodes.resize(count);
+		nodeCount = nodes.size();
+
+		std::vector<size_t> flatten;
+		for (size_t node = 0; node < nodes.size(); node++) {
+			flatten.insert(flatten.end(), nodes[node].begin(), nodes[node].end());
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			switch (affinity) {
+				case ThreadAffinity::Compact:
+				{
+					size_t cpu = flatten[i % flatten.size()];
+					threadCpus[i].emplace_back(cpu);
+					threadNodes[i] = findNode(cpu);
+					break;
+				}
+				case ThreadAffinity::Scatter:
+				{
+					size_t node = i % nodes.size();
+					threadCpus[i].emplace_back(nodes[node][(i / nodes.size()) % nodes[node].size()]);
+					threadNodes[i] = node;
+					break;
+				}
+				case ThreadAffinity::Node:
+				{
+					size_t node = i * nodes.size() / count;
+					threadCpus[i] = nodes[node];
+					threadNodes[i] = node;
+					break;
+				}
+				case ThreadAffinity::Explicit:
+				{
+					if (!cpus.empty()) {
+						size_t cpu = cpus[i % cpus.size()];
+						threadCpus[i].emplace_back(cpu);
+						threadNodes[i] = findNode(cpu);
+					}
+					break;
+				}
+				default:
+					break;
+			}
+		}
+
+		set_thread_initializer([this](size_t threadIndex) {
+			PinCurrentThread(threadCpus[threadIndex]);
+			// let root allocators serve this thread with node-local blocks
+			iris::iris_static_instance_t<iris::iris_arena_index_t>::get_thread_local().value = threadNodes[threadIndex];
+		});
 	}
 
 	void AsyncWorker::Synchronize(LuaState lua, Warp* warp) {
-		auto waiter = [] {std::this_thread::sleep_for(std::chrono::milliseconds(50)); };
+		// wake up as soon as the warp yields, the timeout is just a fallback
+		auto waiter = [warp] { warp->wait_yield(std::chrono::milliseconds(50)); };
 		if (scriptWarp) {
 			assert(Warp::get_current_warp() == scriptWarp.get());
 			lua_State* L = lua.get_state();
-			while ((warp == nullptr || !warp->join(waiter)) || !scriptWarp->join(waiter) || poll()) {
+			while ((warp == nullptr || !warp->join(waiter)) || !scriptWarp->join([this] { scriptWarp->wait_yield(std::chrono::milliseconds(50)); }) || poll()) {
 				scriptWarp->Release();
-				poll_delay(static_cast<size_t>(Priority::Count), std::chrono::milliseconds(20));
+				poll(static_cast<size_t>(Priority::Count));
 				scriptWarp->Acquire();
 			}
 		} else if (warp != nullptr) {
@@ -101,80 +709,206 @@ namespace coluster {
 		rootState = nullptr;
 	}
 
-	void Warp::ChainWait(const std::source_location& source, Warp* from, Warp* target, Warp* other) {
-		if (from != target || from != other) {
-			// printf("$> Warp %p is waiting for Warp: %p\n", from, target);
-			// printf("$> Source file: %s:%d\n", source.file_name(), source.line());
-			Warp* scriptWarp = from != nullptr ? from->get_async_worker().GetScriptWarp() : target != nullptr ? target->get_async_worker().GetScriptWarp() : other->get_async_worker().GetScriptWarp();
-			assert(scriptWarp != nullptr);
-
-			// use raw api for faster operation
-			scriptWarp->queue_routine([address = GetCurrentCoroutineAddress(), source, from, target, other]() {
-				Warp* scriptWarp = Warp::get_current_warp();
-				lua_State* L = scriptWarp->rootState;
-				LuaState::stack_guard_t guard(L);
-				LuaState lua(L);
+	// fixed-size ring of sampled chain states, overwritten by its owner thread
+	struct ChainBuffer {
+		static constexpr size_t capacity = 256;
+
+		struct Record {
+			uint64_t sequence; // global order of recording
+			void* address; // coroutine address
+			uint64_t generation; // coroutine generation of address, see GetCoroutineGeneration()
+			std::source_location source; // for waits only
+			Warp* scriptWarp;
+			Warp* from;
+			Warp* target;
+			Warp* other;
+			bool waiting;
+		};
+
+		// version is 0 while the record is being written, otherwise sequence + 1 of the record published
+		struct Slot {
+			std::atomic<uint64_t> version = 0;
+			Record record;
+		};
+
+		Slot slots[capacity];
+		std::atomic<size_t> writeIndex = 0;
+	};
+
+	std::atomic<size_t> Warp::chainSampling = 0;
+	static std::atomic<uint64_t> ChainSequence = 0;
+	static std::atomic<uint64_t> ChainStartSequence = 0; // records before it are left from previous sampling
+	static std::mutex ChainLock;
+	static std::vector<std::unique_ptr<ChainBuffer>> ChainBuffers; // never shrinks, rings are owned by threads with thread_local pointers
+	static thread_local ChainBuffer* CurrentChainBuffer = nullptr;
+	static thread_local size_t ChainSkipCount = 0;
+
+	void Warp::SetChainSampling(size_t interval) noexcept {
+		// frames started while disabled keep stale generations, so drop all records before reenabling
+		if (interval != 0 && chainSampling.load(std::memory_order_relaxed) == 0) {
+			ChainStartSequence.store(ChainSequence.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
 
-				Ref trace = std::move(*scriptWarp->GetProfileTable().get(lua, "trace"));
+		chainSampling.store(interval, std::memory_order_relaxed);
+	}
 
-				lua_rawgeti(L, LUA_REGISTRYINDEX, trace.get_ref_index());
-				lua_pushlightuserdata(L, address);
-				lua_rawget(L, LUA_REGISTRYINDEX); // get thread
+	size_t Warp::GetChainSampling() noexcept {
+		return chainSampling.load(std::memory_order_relaxed);
+	}
 
-				if (lua_type(L, -1) != LUA_TNIL) {
-					lua_pushfstring(L, "<<Wait>> Warp [%p] ==> Warp [%p][%p] at %s <%s:%d>", from, target, other, source.function_name(), source.file_name(), source.line());
-					// fprintf(stdout, "%s\n", lua_tostring(L, -1));
-					lua_rawset(L, -3);
-					lua_pop(L, 1);
-				} else {
-					lua_pop(L, 2);
-				}
+	void Warp::RecordChain(const std::source_location* source, Warp* from, Warp* target, Warp* other) noexcept {
+		size_t interval = chainSampling.load(std::memory_order_relaxed);
+		if ((from == target && from == other) || interval == 0 || ++ChainSkipCount < interval) {
+			return;
+		}
 
-				lua.deref(std::move(trace));
-			});
+		ChainSkipCount = 0;
+		ChainBuffer* buffer = CurrentChainBuffer;
+		if (buffer == nullptr) {
+			std::lock_guard<std::mutex> guard(ChainLock);
+			buffer = CurrentChainBuffer = ChainBuffers.emplace_back(std::make_unique<ChainBuffer>()).get();
 		}
+
+		Warp* scriptWarp = from != nullptr ? from->get_async_worker().GetScriptWarp() : target != nullptr ? target->get_async_worker().GetScriptWarp() : other->get_async_worker().GetScriptWarp();
+		size_t writeIndex = buffer->writeIndex.load(std::memory_order_relaxed);
+		ChainBuffer::Slot& slot = buffer->slots[writeIndex % ChainBuffer::capacity];
+		slot.version.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		ChainBuffer::Record& record = slot.record;
+		record.sequence = ChainSequence.fetch_add(1, std::memory_order_relaxed);
+		record.address = GetCurrentCoroutineAddress();
+		record.generation = GetCoroutineGeneration(record.address);
+		record.source = source != nullptr ? *source : std::source_location();
+		record.scriptWarp = scriptWarp;
+		record.from = from;
+		record.target = target;
+		record.other = other;
+		record.waiting = source != nullptr;
+		slot.version.store(record.sequence + 1, std::memory_order_release);
+		buffer->writeIndex.store(writeIndex + 1, std::memory_order_release);
 	}
 
-	void Warp::ChainEnter(Warp* from, Warp* target, Warp* other) {
-		if (from != target || from != other) {
-			Warp* scriptWarp = from != nullptr ? from->get_async_worker().GetScriptWarp() : target != nullptr ? target->get_async_worker().GetScriptWarp() : other->get_async_worker().GetScriptWarp();
-			assert(scriptWarp != nullptr);
+	void Warp::CollectChains(LuaState lua) {
+		assert(Warp::get_current_warp() == this);
+		std::vector<ChainBuffer::Record> records;
+
+		do {
+			std::lock_guard<std::mutex> guard(ChainLock);
+			uint64_t startSequence = ChainStartSequence.load(std::memory_order_relaxed);
+			for (auto& buffer : ChainBuffers) {
+				size_t writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+				size_t begin = writeIndex - std::min(writeIndex, ChainBuffer::capacity);
+				for (size_t i = begin; i < writeIndex; i++) {
+					// skip the records being written or overwritten while copying
+					ChainBuffer::Slot& slot = buffer->slots[i % ChainBuffer::capacity];
+					uint64_t version = slot.version.load(std::memory_order_acquire);
+					ChainBuffer::Record record = slot.record;
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (version != 0 && version == slot.version.load(std::memory_order_relaxed) && version == record.sequence + 1 && record.sequence >= startSequence) {
+						records.emplace_back(record);
+					}
+				}
+			}
+		} while (false);
 
-			// use raw api for faster operation
-			scriptWarp->queue_barrier();
-			scriptWarp->queue_routine([address = GetCurrentCoroutineAddress(), from, target, other]() {
-				Warp* scriptWarp = Warp::get_current_warp();
-				lua_State* L = scriptWarp->rootState;
-				LuaState::stack_guard_t guard(L);
-				LuaState lua(L);
+		std::sort(records.begin(), records.end(), [](const ChainBuffer::Record& lhs, const ChainBuffer::Record& rhs) {
+			return lhs.sequence < rhs.sequence;
+		});
 
-				Ref trace = scriptWarp->GetProfileTable().get(lua, "trace").value();
-				lua_rawgeti(L, LUA_REGISTRYINDEX, trace.get_ref_index());
-				lua_pushlightuserdata(L, address);
-				lua_rawget(L, LUA_REGISTRYINDEX); // get thread
+		lua_State* L = lua.get_state();
+		LuaState::stack_guard_t guard(L);
+		Ref trace = std::move(*profileTable.get(lua, "trace"));
+		lua_rawgeti(L, LUA_REGISTRYINDEX, trace.get_ref_index());
 
-				if (lua_type(L, -1) != LUA_TNIL) {
-					lua_pushfstring(L, "<<Running>> Warp [%p] ==> Warp [%p][%p]", from, target, other);
-					// fprintf(stdout, "%s\n", lua_tostring(L, -1));
-					lua_rawset(L, -3);
-					lua_pop(L, 1);
+		// the latest state of each coroutine wins, records of finished frames whose addresses are reused are stale
+		for (const ChainBuffer::Record& record : records) {
+			if (record.scriptWarp != this || record.generation != GetCoroutineGeneration(record.address)) {
+				continue;
+			}
+
+			lua_pushlightuserdata(L, record.address);
+			lua_rawget(L, LUA_REGISTRYINDEX); // get thread
+
+			if (lua_type(L, -1) != LUA_TNIL) {
+				if (record.waiting) {
+					lua_pushfstring(L, "<<Wait>> Warp [%p] ==> Warp [%p][%p] at %s <%s:%d>", record.from, record.target, record.other, record.source.function_name(), record.source.file_name(), record.source.line());
 				} else {
-					lua_pop(L, 2);
+					lua_pushfstring(L, "<<Running>> Warp [%p] ==> Warp [%p][%p]", record.from, record.target, record.other);
 				}
 
-				lua.deref(std::move(trace));
-			});
+				lua_rawset(L, -3);
+			} else {
+				lua_pop(L, 1);
+			}
 		}
+
+		lua_pop(L, 1);
+		lua.deref(std::move(trace));
 	}
 
 	void Warp::Acquire() {
+		auto start = std::chrono::steady_clock::now();
 		while (!preempt()) {
-			if (!get_async_worker().is_terminated()) {
-				get_async_worker().poll_delay(static_cast<size_t>(Priority::Highest), std::chrono::milliseconds(20));
-			} else {
-				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			// help with pending tasks, or sleep until the holder yields this warp
+			AsyncWorker& asyncWorker = get_async_worker();
+			if (asyncWorker.is_terminated() || !asyncWorker.poll(static_cast<size_t>(Priority::Highest))) {
+				wait_yield(std::chrono::milliseconds(20));
 			}
 		}
+
+		RecordAcquire(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+	}
+
+	void Warp::RecordAcquire(uint64_t latency) {
+		static constexpr size_t sampleCount = 1024;
+		if (acquireSamples.size() < sampleCount) {
+			acquireSamples.emplace_back(latency);
+		} else {
+			acquireSamples[acquireCount % sampleCount] = latency;
+		}
+
+		acquireCount++;
+		acquireMax = std::max(acquireMax, latency);
+	}
+
+	Warp::AcquireStats Warp::GetAcquireStats() const {
+		assert(Warp::get_current_warp() == this);
+		AcquireStats stats;
+		stats.count = acquireCount;
+		stats.max = acquireMax;
+
+		if (!acquireSamples.empty()) {
+			std::vector<uint64_t> samples = acquireSamples;
+			std::sort(samples.begin(), samples.end());
+			auto percentile = [&samples](size_t p) { return samples[(samples.size() * p + 99) / 100 - 1]; }; // nearest rank
+			stats.p50 = percentile(50);
+			stats.p90 = percentile(90);
+			stats.p99 = percentile(99);
+		}
+
+		return stats;
+	}
+
+	Ref Warp::GetStatsTable(LuaState lua) const {
+		affinity_stats_t stats = get_affinity_stats();
+		run_stats_t runStats = get_run_stats();
+		size_t affinity = get_affinity();
+		return lua.make_table([&stats, &runStats, affinity](LuaState lua) {
+			if (affinity != ~size_t(0)) {
+				lua.set_current("Affinity", affinity);
+			}
+
+			lua.set_current("ExecuteCount", stats.execute_count);
+			lua.set_current("MigrationCount", stats.migration_count);
+			lua.set_current("AffinityHitCount", stats.affinity_hit_count);
+			lua.set_current("RoutineCount", runStats.routine_count);
+			lua.set_current("RunTime", runStats.run_time);
+
+			double executeCount = static_cast<double>(runStats.execute_count);
+			lua.set_current("AverageRunLength", runStats.execute_count == 0 ? 0.0 : static_cast<double>(runStats.routine_count) / executeCount);
+			lua.set_current("AverageRunTime", runStats.execute_count == 0 ? 0.0 : static_cast<double>(runStats.run_time) / executeCount);
+		});
 	}
 
 	void Warp::Release() {
@@ -191,6 +925,8 @@ namespace coluster {
 	}
 
 	void Warp::SwitchWarp::await_suspend(std::coroutine_handle<> handle) {
+		TraceInstant("Warp::Switch");
+		suspendTicks = GetLatencyTicks();
 		return Base::await_suspend(handle);
 	}
 
@@ -199,6 +935,10 @@ namespace coluster {
 		Warp* ret = Base::await_resume();
 		assert(ret == Base::source);
 
+		if (suspendTicks != 0) {
+			RecordLatency(LatencyType::WarpSwitch, suspendTicks);
+		}
+
 		Warp::ChainEnter(Base::source, Base::target, Base::other);
 		return ret;
 	}
@@ -229,4 +969,38 @@ namespace coluster {
 	Warp* Object::GetObjectWarp() const noexcept {
 		return nullptr;
 	}
+
+	bool Object::SetObjectWarpAffinity(size_t threadIndex) noexcept {
+		Warp* warp = GetObjectWarp();
+		if (warp == nullptr) {
+			return false;
+		}
+
+		// out of range index removes the binding
+		bool valid = threadIndex < warp->get_async_worker().get_thread_count();
+		warp->set_affinity(valid ? threadIndex : ~size_t(0));
+		return valid;
+	}
+
+	Ref Object::GetObjectWarpStats(LuaState lua) {
+		Warp* warp = GetObjectWarp();
+		if (warp == nullptr) {
+			return Ref();
+		}
+
+		return warp->GetStatsTable(lua);
+	}
+
+	void CancelToken::lua_registar(LuaState lua) {
+		lua.set_current<&CancelToken::Cancel>("Cancel");
+		lua.set_current<&CancelToken::IsCancelled>("IsCancelled");
+	}
+
+	bool CancelToken::Cancel() {
+		return cancel();
+	}
+
+	bool CancelToken::IsCancelled() const noexcept {
+		return is_cancelled();
+	}
 }
\ No newline at end of file
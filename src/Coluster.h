@@ -42,6 +42,30 @@
 
 #define IRIS_SHARED_LIBRARY_DECORATOR COLUSTER_API
 
+// profile hooks of iris, events are recorded into per-thread rings only while tracing is enabled, see EnableTrace()
+namespace coluster {
+	COLUSTER_API bool TraceBegin(const char* name) noexcept; // name must be a static string
+	COLUSTER_API void TraceEnd(bool force = false) noexcept;
+	COLUSTER_API void TraceThread(const char* name, size_t index) noexcept;
+
+	struct TraceScope {
+		explicit TraceScope(const char* name) noexcept : recorded(TraceBegin(name)) {}
+		~TraceScope() noexcept {
+			// always close the span even if tracing is disabled in the middle
+			if (recorded) {
+				TraceEnd(true);
+			}
+		}
+
+		bool recorded;
+	};
+}
+
+#define IRIS_PROFILE_THREAD(name, i) coluster::TraceThread(name, i)
+#define IRIS_PROFILE_SCOPE(name) coluster::TraceScope iris_profile_scope(name)
+#define IRIS_PROFILE_PUSH(name) coluster::TraceBegin(name)
+#define IRIS_PROFILE_POP() coluster::TraceEnd()
+
 #include "../ref/iris/src/iris_coroutine.h"
 #include "../ref/iris/src/iris_buffer.h"
 #include "../ref/iris/src/iris_lua.h"
@@ -89,33 +113,136 @@ namespace coluster {
 		Count
 	};
 
+	// allocation-free callables for tasks and warp routines, captures that do not fit are rejected at compile time
+	using TaskFunction = iris::iris_inline_function_t<64>;
+	using RoutineFunction = iris::iris_inline_function_t<48>;
+
 	COLUSTER_API void SetCurrentCoroutineAddress(void* address) noexcept;
 	COLUSTER_API void* GetCurrentCoroutineAddress() noexcept;
+	// same as SetCurrentCoroutineAddress() but for a newly started frame, which may reuse the address of a finished one
+	COLUSTER_API void BeginCoroutineAddress(void* address) noexcept;
+	// bumped by BeginCoroutineAddress(), frames hashed into the same slot share a generation
+	COLUSTER_API uint64_t GetCoroutineGeneration(void* address) noexcept;
+
+	// recorded by IRIS_PROFILE_XXX and TraceInstant()
+	struct TraceEvent {
+		uint64_t timestamp; // nanoseconds of steady clock
+		const char* name;
+		const void* warp; // current warp on recording
+		char phase; // 'B' for begin, 'E' for end, 'i' for instant
+	};
+
+	struct TraceThreadEvents {
+		uint32_t thread;
+		std::string name;
+		std::vector<TraceEvent> events;
+	};
+
+	COLUSTER_API void TraceInstant(const char* name) noexcept;
+	// events recorded before enabling are discarded
+	COLUSTER_API void EnableTrace(bool enable) noexcept;
+	COLUSTER_API bool IsTraceEnabled() noexcept;
+	// move out pending events of all threads, returns the count of events dropped on full rings since last collection
+	COLUSTER_API uint64_t CollectTrace(std::vector<TraceThreadEvents>& threads);
+
+	// wait latencies of awaitables, recorded into per-thread log-bucketed histograms
+	enum class LatencyType : size_t {
+		HostQuota = 0,
+		DeviceQuota,
+		FileIO,
+		DeviceSubmit,
+		WarpSwitch,
+		PipePop,
+		Count
+	};
+
+	// in nanoseconds, percentiles are upper bounds of histogram buckets (within 1/16 of the real values)
+	struct LatencyStats {
+		uint64_t count = 0;
+		uint64_t mean = 0;
+		uint64_t p50 = 0;
+		uint64_t p90 = 0;
+		uint64_t p99 = 0;
+		uint64_t p999 = 0;
+		uint64_t max = 0;
+	};
+
+	// raw timestamp for RecordLatency(), much cheaper than steady_clock
+	COLUSTER_API uint64_t GetLatencyTicks() noexcept;
+	// record the latency since startTicks, 0 for a wait finished without suspending
+	COLUSTER_API void RecordLatency(LatencyType type, uint64_t startTicks) noexcept;
+	// merged from all threads since the last reset
+	COLUSTER_API LatencyStats GetLatencyStats(LatencyType type);
+	COLUSTER_API void ResetLatencyStats();
+	COLUSTER_API const char* GetLatencyTypeName(LatencyType type) noexcept;
+
+	enum class QuotaType : size_t {
+		HostMemory = 0,
+		DeviceMemory,
+		Count
+	};
 
 	template <typename quantity_t, size_t n>
 	using Quota = iris::iris_quota_t<quantity_t, n>;
 	template <typename quota_t, typename warp_t, typename async_worker_t>
 	struct QuotaQueue : iris::iris_quota_queue_t<quota_t, warp_t, async_worker_t> {
 		using Base = iris::iris_quota_queue_t<quota_t, warp_t, async_worker_t>;
-		QuotaQueue(async_worker_t& worker, quota_t& q) : Base(worker, q) {}
+		// one waiting class per task priority, see Priority
+		QuotaQueue(async_worker_t& worker, quota_t& q, size_t tagCount = 1, size_t bypassLimit = Base::default_bypass_limit) : Base(worker, q, static_cast<size_t>(Priority::Count), bypassLimit, tagCount) {}
 
 		struct awaitable_t : Base::awaitable_t {
 			using BaseAwaitable = typename Base::awaitable_t;
-			awaitable_t(QuotaQueue& q, const typename Base::amount_t& m, bool r) noexcept : BaseAwaitable(q, m, r), coroutineAddress(GetCurrentCoroutineAddress()) {
+			awaitable_t(QuotaQueue& q, const typename Base::amount_t& m, bool r, iris::iris_cancel_token_t* token = nullptr, Priority priority = Priority::Normal, size_t tag = 0) noexcept : BaseAwaitable(q, m, r, token, static_cast<size_t>(priority), tag), coroutineAddress(GetCurrentCoroutineAddress()) {
 				SetCurrentCoroutineAddress(nullptr);
 			}
 		
-			auto await_resume() noexcept {
+			bool await_suspend(std::coroutine_handle<> handle) {
+				suspendTicks = GetLatencyTicks();
+				return BaseAwaitable::await_suspend(std::move(handle));
+			}
+
+			auto await_resume() {
 				SetCurrentCoroutineAddress(coroutineAddress);
+				// quotas with any device memory are counted as device waits
+				if constexpr (static_cast<size_t>(QuotaType::DeviceMemory) < std::tuple_size_v<typename Base::amount_t>) {
+					RecordLatency(BaseAwaitable::amount[static_cast<size_t>(QuotaType::DeviceMemory)] != 0 ? LatencyType::DeviceQuota : LatencyType::HostQuota, suspendTicks);
+				} else {
+					RecordLatency(LatencyType::HostQuota, suspendTicks);
+				}
+
 				return BaseAwaitable::await_resume();
 			}
 
+			void* GetCoroutineAddress() const noexcept {
+				return coroutineAddress;
+			}
+
 		protected:
 			void* coroutineAddress;
+			uint64_t suspendTicks = 0;
 		};
 
 		awaitable_t guard(const typename Base::amount_t& amount) {
-			return awaitable_t(*this, amount, Base::quota.acquire(amount));
+			return awaitable_t(*this, amount, Base::acquire_unqueued(amount));
+		}
+
+		// resumes with an empty resource once token is cancelled
+		awaitable_t guard(const typename Base::amount_t& amount, iris::iris_cancel_token_t* token, Priority priority = Priority::Normal) {
+			if (token != nullptr && token->is_cancelled()) {
+				return awaitable_t(*this, amount, false, token, priority);
+			}
+
+			return awaitable_t(*this, amount, Base::acquire_unqueued(amount), token, priority);
+		}
+
+		// tagged version, usages of each tag are tracked, see get_usage()
+		template <typename tag_t> requires std::is_enum_v<tag_t>
+		awaitable_t guard(const typename Base::amount_t& amount, tag_t tag, iris::iris_cancel_token_t* token = nullptr, Priority priority = Priority::Normal) {
+			if (token != nullptr && token->is_cancelled()) {
+				return awaitable_t(*this, amount, false, token, priority, static_cast<size_t>(tag));
+			}
+
+			return awaitable_t(*this, amount, Base::acquire_unqueued(amount), token, priority, static_cast<size_t>(tag));
 		}
 
 		typename Base::amount_t GetAmount() const noexcept {
@@ -123,20 +250,41 @@ namespace coluster {
 		}
 	};
 
-	enum class QuotaType : size_t {
-		HostMemory = 0,
-		DeviceMemory,
+	// memory usages are tracked per category
+	enum class MemoryCategory : size_t {
+		Other = 0,
+		DataBuffer,
+		DataPipe,
+		File,
+		Texture,
+		Image,
+		Buffer,
 		Count
 	};
 
+	// how worker threads are pinned to cpus
+	enum class ThreadAffinity : uint8_t {
+		None,
+		Compact, // fill cpus of one NUMA node before moving to the next one
+		Scatter, // round-robin threads across NUMA nodes
+		Node, // pin groups of threads to all cpus of their NUMA node
+		Explicit // pin threads to the given cpu list in order
+	};
+
 	struct Warp;
-	struct AsyncWorker : iris::iris_async_worker_t<> {
-		using Base = iris::iris_async_worker_t<>;
+	struct AsyncWorker : iris::iris_async_worker_t<std::thread, TaskFunction> {
+		using Base = iris::iris_async_worker_t<std::thread, TaskFunction>;
 		using MemoryQuota = Quota<size_t, static_cast<size_t>(QuotaType::Count)>; // Main Memory & Device Memory
 		using MemoryQuotaQueue = QuotaQueue<MemoryQuota, Warp, AsyncWorker>;
 		AsyncWorker();
 
 		COLUSTER_API MemoryQuotaQueue& GetMemoryQuotaQueue() noexcept;
+		// the total amount can be raised or lowered at runtime, quota already held is not affected
+		COLUSTER_API void SetMemoryBudget(const MemoryQuota::amount_t& budget);
+		COLUSTER_API MemoryQuota::amount_t GetMemoryBudget() const noexcept;
+		COLUSTER_API MemoryQuota::amount_t GetMemoryUsage(MemoryCategory category) const noexcept;
+		// half of the memory available to this process, limited by cgroup v2 memory.max, 0 if unknown
+		COLUSTER_API static size_t DetectHostMemoryBudget();
 		COLUSTER_API void Synchronize(LuaState lua, Warp* warp);
 		Warp* GetScriptWarp() const noexcept {
 			return scriptWarp.get();
@@ -146,17 +294,30 @@ namespace coluster {
 			return sharedWarps;
 		}
 
+		// cpu lists of NUMA nodes, at least one node is returned
+		COLUSTER_API static std::vector<std::vector<size_t>> DetectTopology();
+		COLUSTER_API size_t GetThreadNode(size_t threadIndex) const noexcept;
+		size_t GetNodeCount() const noexcept {
+			return nodeCount;
+		}
+
 	protected:
+		void SetupAffinity(ThreadAffinity affinity, std::vector<size_t>&& cpus);
 		void SetupSharedWarps(size_t count);
 
 		std::unique_ptr<Warp> scriptWarp;
 		std::vector<std::shared_ptr<Warp>> sharedWarps;
+		std::vector<std::vector<size_t>> threadCpus;
+		std::vector<size_t> threadNodes;
+		size_t nodeCount = 1;
+		mutable std::mutex memoryBudgetLock;
+		MemoryQuota::amount_t memoryBudget;
 		MemoryQuota memoryQuota;
 		MemoryQuotaQueue memoryQuotaQueue;
 	};
 
-	struct Warp : iris::iris_warp_t<AsyncWorker> {
-		using Base = iris::iris_warp_t<AsyncWorker>;
+	struct Warp : iris::iris_warp_t<AsyncWorker, false, RoutineFunction> {
+		using Base = iris::iris_warp_t<AsyncWorker, false, RoutineFunction>;
 		
 		struct SwitchWarp : iris::iris_switch_t<Warp> {
 			using Base = iris::iris_switch_t<Warp>;
@@ -164,9 +325,13 @@ namespace coluster {
 			COLUSTER_API bool await_ready() const noexcept;
 			COLUSTER_API void await_suspend(std::coroutine_handle<> handle);
 			COLUSTER_API Warp* await_resume() const noexcept;
+			void* GetCoroutineAddress() const noexcept {
+				return coroutineAddress;
+			}
 
 		protected:
 			void* coroutineAddress;
+			uint64_t suspendTicks = 0; // switches finished in await_ready() are not recorded
 		};
 
 		COLUSTER_API static Warp* get_current_warp() noexcept;
@@ -183,12 +348,50 @@ namespace coluster {
 			return profileTable;
 		}
 
-		COLUSTER_API static void ChainWait(const std::source_location& source, Warp* from, Warp* target, Warp* other);
-		COLUSTER_API static void ChainEnter(Warp* from, Warp* target, Warp* other);
+		// latency of Acquire() in nanoseconds, percentiles are computed from recent samples
+		struct AcquireStats {
+			uint64_t count = 0;
+			uint64_t p50 = 0;
+			uint64_t p90 = 0;
+			uint64_t p99 = 0;
+			uint64_t max = 0;
+		};
+
+		// must be called on this warp, samples are written by Acquire() with the warp held
+		COLUSTER_API AcquireStats GetAcquireStats() const;
+		// affinity and run counters in a table, see get_affinity_stats() and get_run_stats()
+		COLUSTER_API Ref GetStatsTable(LuaState lua) const;
+
+		// cross-warp waits and entries of coroutines are sampled into per-thread rings while chain sampling is enabled
+		// the rings are read lazily by CollectChains(), so it costs only a relaxed load on switching if disabled
+		static void ChainWait(const std::source_location& source, Warp* from, Warp* target, Warp* other) noexcept {
+			if (chainSampling.load(std::memory_order_relaxed) != 0) {
+				RecordChain(&source, from, target, other);
+			}
+		}
+
+		static void ChainEnter(Warp* from, Warp* target, Warp* other) noexcept {
+			if (chainSampling.load(std::memory_order_relaxed) != 0) {
+				RecordChain(nullptr, from, target, other);
+			}
+		}
+
+		// record one of every interval switches, 0 for disabling
+		COLUSTER_API static void SetChainSampling(size_t interval) noexcept;
+		COLUSTER_API static size_t GetChainSampling() noexcept;
+		// update the latest chain state of each coroutine into profile table "trace", must be called on this script warp
+		COLUSTER_API void CollectChains(LuaState lua);
 
 	protected:
+		void RecordAcquire(uint64_t latency);
+		COLUSTER_API static void RecordChain(const std::source_location* source, Warp* from, Warp* target, Warp* other) noexcept;
+		COLUSTER_API static std::atomic<size_t> chainSampling;
+
 		lua_State* rootState = nullptr;
 		Ref profileTable;
+		std::vector<uint64_t> acquireSamples; // ring buffer, written with warp acquired
+		uint64_t acquireCount = 0;
+		uint64_t acquireMax = 0;
 	};
 
 	using RootAlloator = std::remove_reference_t<decltype(coluster::AsyncWorker::task_allocator_t::get_root_allocator())>;
@@ -202,7 +405,7 @@ namespace coluster {
 
 		template <typename func_t>
 		Coroutine& complete(func_t&& func) noexcept {
-			SetCurrentCoroutineAddress(Base::get_handle().address());
+			BeginCoroutineAddress(Base::get_handle().address());
 
 			if constexpr (!std::is_void_v<return_t>) {
 				Base::complete([
@@ -246,8 +449,231 @@ namespace coluster {
 	using CoroutineHandle = std::coroutine_handle<return_t>;
 	using AsyncEvent = iris::iris_event_t<Warp, AsyncWorker>;
 	using AsyncBarrier = iris::iris_barrier_t<Warp, AsyncWorker>;
+	// single consumer pipe, pop waits are recorded as LatencyType::PipePop
 	template <typename element_t>
-	using AsyncPipe = iris::iris_pipe_t<element_t, Warp>;
+	struct AsyncPipe : iris::iris_pipe_t<element_t, Warp> {
+		using Base = iris::iris_pipe_t<element_t, Warp>;
+		using Base::Base;
+
+		// the pusher may resume us on another thread, so detach the current coroutine address while suspended
+		void await_suspend(std::coroutine_handle<> handle) noexcept {
+			suspendTicks = GetLatencyTicks();
+			coroutineAddress = GetCurrentCoroutineAddress();
+			SetCurrentCoroutineAddress(nullptr);
+			Base::await_suspend(std::move(handle));
+		}
+
+		element_t await_resume() noexcept {
+			RecordLatency(LatencyType::PipePop, suspendTicks);
+			if (suspendTicks != 0) {
+				SetCurrentCoroutineAddress(coroutineAddress);
+				suspendTicks = 0;
+				coroutineAddress = nullptr;
+			}
+
+			return Base::await_resume();
+		}
+
+		void* GetCoroutineAddress() const noexcept {
+			return coroutineAddress;
+		}
+
+	protected:
+		uint64_t suspendTicks = 0;
+		void* coroutineAddress = nullptr;
+	};
+
+	// resumed by a timer task on any thread, so detach the current coroutine address while waiting
+	struct AsyncSleep : iris::iris_sleep_t<Warp, AsyncWorker> {
+		using Base = iris::iris_sleep_t<Warp, AsyncWorker>;
+		template <typename duration_t>
+		AsyncSleep(AsyncWorker& worker, duration_t&& duration) : Base(worker, std::forward<duration_t>(duration)), coroutineAddress(GetCurrentCoroutineAddress()) {
+			SetCurrentCoroutineAddress(nullptr);
+		}
+
+		void await_resume() const noexcept {
+			SetCurrentCoroutineAddress(coroutineAddress);
+		}
+
+		void* GetCoroutineAddress() const noexcept {
+			return coroutineAddress;
+		}
+
+	protected:
+		void* coroutineAddress;
+	};
+
+	// awaited inside the background coroutine of AsyncTimeout, the address restored by the awaitable is cleared on resuming
+	template <typename awaitable_t>
+	struct AsyncDetached {
+		using holder_t = std::conditional_t<std::is_lvalue_reference_v<awaitable_t>, std::remove_reference_t<awaitable_t>*, std::remove_reference_t<awaitable_t>>;
+		explicit AsyncDetached(awaitable_t&& a) : holder(Hold(std::forward<awaitable_t>(a))) {}
+
+		bool await_ready() {
+			return Get().await_ready();
+		}
+
+		template <typename handle_t>
+		decltype(auto) await_suspend(handle_t&& handle) {
+			return Get().await_suspend(std::forward<handle_t>(handle));
+		}
+
+		decltype(auto) await_resume() {
+			struct Guard {
+				~Guard() noexcept { SetCurrentCoroutineAddress(nullptr); }
+			} guard;
+
+			return Get().await_resume();
+		}
+
+	protected:
+		static holder_t Hold(awaitable_t&& a) {
+			if constexpr (std::is_lvalue_reference_v<awaitable_t>) {
+				return &a;
+			} else {
+				return std::move(a);
+			}
+		}
+
+		std::remove_reference_t<awaitable_t>& Get() noexcept {
+			if constexpr (std::is_lvalue_reference_v<awaitable_t>) {
+				return *holder;
+			} else {
+				return holder;
+			}
+		}
+
+		holder_t holder;
+	};
+
+	// the awaitable keeps running in a background coroutine, so detach the current coroutine address while waiting
+	// coluster awaitables detach the address on construction, which is taken back by GetCoroutineAddress()
+	template <typename awaitable_t>
+	struct AsyncTimeout : iris::iris_timeout_t<Warp, AsyncDetached<awaitable_t>, AsyncWorker> {
+		using Base = iris::iris_timeout_t<Warp, AsyncDetached<awaitable_t>, AsyncWorker>;
+		template <typename duration_t>
+		AsyncTimeout(AsyncWorker& worker, awaitable_t&& awaitable, duration_t&& duration) : AsyncTimeout(worker, TakeCoroutineAddress(awaitable), std::forward<awaitable_t>(awaitable), std::forward<duration_t>(duration)) {}
+
+		auto await_resume() noexcept {
+			SetCurrentCoroutineAddress(coroutineAddress);
+			return Base::await_resume();
+		}
+
+		void* GetCoroutineAddress() const noexcept {
+			return coroutineAddress;
+		}
+
+	protected:
+		template <typename duration_t>
+		AsyncTimeout(AsyncWorker& worker, void* address, awaitable_t&& awaitable, duration_t&& duration) : Base(worker, AsyncDetached<awaitable_t>(std::forward<awaitable_t>(awaitable)), std::forward<duration_t>(duration)), coroutineAddress(address) {}
+
+		static void* TakeCoroutineAddress(const std::remove_reference_t<awaitable_t>& awaitable) noexcept {
+			void* address = GetCurrentCoroutineAddress();
+			if constexpr (requires { awaitable.GetCoroutineAddress(); }) {
+				if (address == nullptr) {
+					address = awaitable.GetCoroutineAddress();
+				}
+			}
+
+			SetCurrentCoroutineAddress(nullptr);
+			return address;
+		}
+
+		void* coroutineAddress;
+	};
+
+	// co_await Sleep(duration) suspends current coroutine without blocking the thread, must be called on a warp
+	template <typename duration_t>
+	AsyncSleep Sleep(duration_t&& duration) {
+		Warp* currentWarp = Warp::get_current_warp();
+		assert(currentWarp != nullptr);
+		return AsyncSleep(currentWarp->get_async_worker(), std::forward<duration_t>(duration));
+	}
+
+	// co_await WithTimeout(awaitable, duration) returns std::optional<result> (or bool for void), empty on timeout
+	// the awaitable is not cancelled on timeout, see iris::iris_timeout_t
+	template <typename awaitable_t, typename duration_t>
+	AsyncTimeout<awaitable_t&&> WithTimeout(awaitable_t&& awaitable, duration_t&& duration) {
+		Warp* currentWarp = Warp::get_current_warp();
+		assert(currentWarp != nullptr);
+		return AsyncTimeout<awaitable_t&&>(currentWarp->get_async_worker(), std::forward<awaitable_t>(awaitable), std::forward<duration_t>(duration));
+	}
+
+	// child coroutines are started inside the awaiting one, so detach the current coroutine address while waiting
+	template <typename... coroutines_t>
+	struct AsyncWhenAll : iris::iris_when_all_t<Warp, AsyncWorker, coroutines_t...> {
+		using Base = iris::iris_when_all_t<Warp, AsyncWorker, coroutines_t...>;
+		AsyncWhenAll(AsyncWorker& worker, coroutines_t&&... coroutines) : Base(worker, std::move(coroutines)...), coroutineAddress(GetCurrentCoroutineAddress()) {
+			SetCurrentCoroutineAddress(nullptr);
+		}
+
+		auto await_resume() {
+			SetCurrentCoroutineAddress(coroutineAddress);
+			return Base::await_resume();
+		}
+
+		void* GetCoroutineAddress() const noexcept {
+			return coroutineAddress;
+		}
+
+	protected:
+		void* coroutineAddress;
+	};
+
+	template <typename coroutine_t>
+	struct AsyncWhenAny : iris::iris_when_any_t<Warp, coroutine_t, AsyncWorker> {
+		using Base = iris::iris_when_any_t<Warp, coroutine_t, AsyncWorker>;
+		AsyncWhenAny(AsyncWorker& worker, std::vector<coroutine_t>&& coroutines) : Base(worker, std::move(coroutines)), coroutineAddress(GetCurrentCoroutineAddress()) {
+			SetCurrentCoroutineAddress(nullptr);
+		}
+
+		auto await_resume() {
+			SetCurrentCoroutineAddress(coroutineAddress);
+			return Base::await_resume();
+		}
+
+		void* GetCoroutineAddress() const noexcept {
+			return coroutineAddress;
+		}
+
+	protected:
+		void* coroutineAddress;
+	};
+
+	// co_await WhenAll(coroutines...) runs coroutines concurrently and returns std::tuple of results (bool for void)
+	// the current coroutine is resumed only once after all completed, must be called on a warp
+	template <typename... coroutines_t>
+	AsyncWhenAll<std::decay_t<coroutines_t>...> WhenAll(coroutines_t&&... coroutines) {
+		Warp* currentWarp = Warp::get_current_warp();
+		assert(currentWarp != nullptr);
+		return AsyncWhenAll<std::decay_t<coroutines_t>...>(currentWarp->get_async_worker(), std::move(coroutines)...);
+	}
+
+	// co_await WhenAny(coroutines) returns std::pair of the index and result of the first completed one
+	// the rest ones keep running in background
+	template <typename coroutine_t>
+	AsyncWhenAny<coroutine_t> WhenAny(std::vector<coroutine_t>&& coroutines) {
+		Warp* currentWarp = Warp::get_current_warp();
+		assert(currentWarp != nullptr);
+		return AsyncWhenAny<coroutine_t>(currentWarp->get_async_worker(), std::move(coroutines));
+	}
+
+	// co_await ParallelFor(begin, end, grain, func) calls func(subBegin, subEnd) on sub-ranges no larger than grain across all threads
+	// sub-ranges are split recursively and stealable, the current coroutine is resumed on its warp once all completed
+	template <typename index_t, typename func_t>
+	iris::iris_parallel_for_t<Warp, index_t, std::decay_t<func_t>, AsyncWorker> ParallelFor(index_t begin, index_t end, index_t grain, func_t&& func) {
+		Warp* currentWarp = Warp::get_current_warp();
+		assert(currentWarp != nullptr);
+		return iris::iris_parallel_for<Warp>(currentWarp->get_async_worker(), begin, end, grain, std::forward<func_t>(func));
+	}
+
+	// co_await ParallelReduce(begin, end, grain, init, map, combine) returns init folded with map(subBegin, subEnd) of all sub-ranges in order
+	template <typename index_t, typename value_t, typename map_t, typename combine_t>
+	iris::iris_parallel_reduce_t<Warp, index_t, std::decay_t<value_t>, std::decay_t<map_t>, std::decay_t<combine_t>, AsyncWorker> ParallelReduce(index_t begin, index_t end, index_t grain, value_t&& init, map_t&& map, combine_t&& combine) {
+		Warp* currentWarp = Warp::get_current_warp();
+		assert(currentWarp != nullptr);
+		return iris::iris_parallel_reduce<Warp>(currentWarp->get_async_worker(), begin, end, grain, std::forward<value_t>(init), std::forward<map_t>(map), std::forward<combine_t>(combine));
+	}
 
 	struct AutoAsyncWorker : LuaState::required_base_t {
 		struct Holder {
@@ -289,6 +715,25 @@ namespace coluster {
 		COLUSTER_API Object() noexcept;
 		COLUSTER_API virtual ~Object() noexcept;
 		COLUSTER_API virtual Warp* GetObjectWarp() const noexcept;
+
+	protected:
+		// helpers for objects running on their own warp, see iris_warp_t::set_affinity()
+		COLUSTER_API bool SetObjectWarpAffinity(size_t threadIndex) noexcept;
+		COLUSTER_API Ref GetObjectWarpStats(LuaState lua);
+	};
+
+	// cooperative cancellation token passed from lua to cancellable coroutine methods
+	// methods check it at warp switch points and quota waits and return ResultError("cancelled") early
+	class CancelToken : public Object, public iris::iris_cancel_token_t {
+	public:
+		COLUSTER_API static void lua_registar(LuaState lua);
+
+		COLUSTER_API bool Cancel();
+		COLUSTER_API bool IsCancelled() const noexcept;
+
+		static bool Check(const CancelToken* token) noexcept {
+			return token != nullptr && token->is_cancelled();
+		}
 	};
 
 	struct StackIndex {
@@ -300,7 +745,10 @@ namespace coluster {
 namespace iris {
 	declare_shared_static_instance(coluster::Warp::Base*);
 	declare_shared_static_instance(coluster::AsyncWorker::thread_index_t);
+	declare_shared_static_instance(iris::iris_arena_index_t);
 	declare_shared_static_instance(coluster::RootAlloator);
+	declare_shared_static_instance(iris::iris_default_frame_pool_t::global_t);
+	declare_shared_static_instance(iris::iris_default_frame_pool_t::thread_cache_t);
 
 	template <>
 	struct iris_lua_convert_t<coluster::AutoAsyncWorker::Holder> {
@@ -1,6 +1,8 @@
 #include "Coluster.h"
 #include "../ref/iris/src/iris_common.inl" // implementation of memory management apis
 #include <chrono>
+#include <limits>
+#include <unordered_map>
 #include <signal.h>
 using namespace coluster;
 
@@ -28,6 +30,33 @@ int luaL_requiref(lua_State* L, const char* modname, lua_CFunction openf, int gl
 
 #include "plugins.inl"
 
+// drives the active thread count with iris_async_balancer_t, which limits threads by the count of paused ones
+struct ActiveThreadLimiter {
+	ActiveThreadLimiter(AsyncWorker& worker, size_t capacity, size_t minimum) noexcept : asyncWorker(worker), threadCapacity(capacity), minimumCount(minimum) {}
+
+	void limit(size_t count) {
+		asyncWorker.set_active_count(std::max(threadCapacity - std::min(count, threadCapacity), minimumCount));
+	}
+
+	size_t get_thread_count() const noexcept {
+		return threadCapacity;
+	}
+
+	// the inverse of limit(), so the balancer can start from the active count Resize() left behind
+	size_t get_limit() const noexcept {
+		return threadCapacity - std::min(asyncWorker.get_active_count(), threadCapacity);
+	}
+
+	size_t get_task_count() const noexcept {
+		return asyncWorker.get_task_count();
+	}
+
+protected:
+	AsyncWorker& asyncWorker;
+	size_t threadCapacity;
+	size_t minimumCount;
+};
+
 class Coluster : public AsyncWorker {
 public:
 	enum class Status : size_t {
@@ -45,14 +74,39 @@ public:
 
 	// Methods
 	std::string_view GetStatus() const noexcept;
-	Result<bool> Start(LuaState lua, size_t threadCount);
+	Result<bool> Start(LuaState lua, size_t threadCount, Ref&& options);
 	Result<bool> Join(LuaState lua, Ref&& finalizer, bool enableConsole);
 	Result<bool> Post(LuaState lua, Ref&& callback);
+	Result<size_t> Resize(size_t threadCount);
+	size_t GetActiveThreadCount() const noexcept;
+	Result<size_t> PostBatch(LuaState lua, Ref&& callbacks);
 	bool Poll(bool pollAsyncTasks);
 	bool Stop();
 	void Sleep(size_t milliseconds);
+	Coroutine<void> SleepAsync(size_t milliseconds);
+	Coroutine<Result<size_t>> PingWarps(size_t milliseconds);
+	Coroutine<Result<Ref>> WhenAll(LuaState lua, Ref&& routines);
+	Coroutine<Result<Ref>> WhenAny(LuaState lua, Ref&& routines);
 	Result<Ref> GetProfile(LuaState lua);
+	void SetChainSampling(size_t interval) noexcept;
+	size_t GetChainSampling() const noexcept;
+	Result<bool> StartProfiler(LuaState lua, size_t instructionCount);
+	bool StopProfiler(LuaState lua);
+	std::string GetProfilerStacks(bool reset);
+	size_t GetProfilerSampleCount() const noexcept;
+	Ref GetIdleStats(LuaState lua);
+	Ref GetSwitchStats(LuaState lua);
+	Ref GetStats(LuaState lua);
+	Ref GetLatencyStats(LuaState lua);
+	Ref GetSimulationStats(LuaState lua);
+	void ResetLatencyStats();
+	Ref GetTopology(LuaState lua);
+	Ref GetFrameStats(LuaState lua);
+	Ref TypeCancelToken(LuaState lua);
 	AsyncWorker::MemoryQuota::amount_t GetQuota() noexcept;
+	Ref SetMemoryBudget(LuaState lua, Ref&& budget);
+	Ref GetMemoryBudget(LuaState lua);
+	Ref GetMemoryUsage(LuaState lua);
 
 	static size_t GetHardwareConcurrency() noexcept;
 	size_t GetWorkerThreadCount() const noexcept;
@@ -61,18 +115,39 @@ public:
 	bool IsWorkerTerminated() const noexcept;
 
 protected:
+	Coroutine<Result<Ref>> Fanout(LuaState lua, Ref&& routines, bool waitAny);
+	void BalanceThreads();
+	void ScheduleBalance();
 	void doREPL(lua_State* L);
 	int pushline(lua_State* L, int firstline);
 	int multiline(lua_State* L);
 	int loadline(lua_State* L);
+	void SetProfilerHook(LuaState lua, int mask, int count);
+	void SampleStack(lua_State* L);
+	static Coluster* GetProfilingInstance(lua_State* L) noexcept;
+	static void SetProfilingInstance(lua_State* L, Coluster* instance) noexcept;
 
 protected:
 	LuaState cothread;
 	Ref cothreadRef;
 	size_t mainThreadIndex = ~size_t(0);
+	size_t threadCapacity = 0;
 	std::atomic<Status> workerStatus = Status::Ready;
+	std::mutex resizeMutex; // serializes Resize() against BalanceThreads(), so that only one of them owns the active count at a time
+	std::atomic<bool> autoResize = false;
+	std::unique_ptr<ActiveThreadLimiter> threadLimiter;
+	std::unique_ptr<iris::iris_async_balancer_t<ActiveThreadLimiter>> threadBalancer; // protected by resizeMutex
+
+	// sampled lua stacks, keyed by collapsed frames "outer;...;inner". lua states are never run concurrently, so no locking is required
+	// the profiling instance is stored in the registry of its own lua state, so hooks never sample on behalf of another state
+	static const char profilingInstanceKey;
+	std::unordered_map<std::string, size_t> profilerStacks;
+	std::string profilerFrames;
+	size_t profilerSampleCount = 0;
 };
 
+const char Coluster::profilingInstanceKey = 0;
+
 Coluster::Coluster() : cothread(nullptr) {}
 
 // Lua stubs
@@ -80,11 +155,36 @@ void Coluster::lua_registar(LuaState lua) {
 	lua.set_current<&Coluster::Start>("Start");
 	lua.set_current<&Coluster::Join>("Join");
 	lua.set_current<&Coluster::Post>("Post");
+	lua.set_current<&Coluster::PostBatch>("PostBatch");
+	lua.set_current<&Coluster::Resize>("Resize");
+	lua.set_current<&Coluster::GetActiveThreadCount>("GetActiveThreadCount");
 	lua.set_current<&Coluster::Poll>("Poll");
 	lua.set_current<&Coluster::Stop>("Stop");
 	lua.set_current<&Coluster::Sleep>("Sleep");
+	lua.set_current<&Coluster::SleepAsync>("SleepAsync");
+	lua.set_current<&Coluster::PingWarps>("PingWarps");
+	lua.set_current<&Coluster::WhenAll>("WhenAll");
+	lua.set_current<&Coluster::WhenAny>("WhenAny");
 	lua.set_current<&Coluster::GetProfile>("GetProfile");
+	lua.set_current<&Coluster::SetChainSampling>("SetChainSampling");
+	lua.set_current<&Coluster::GetChainSampling>("GetChainSampling");
+	lua.set_current<&Coluster::StartProfiler>("StartProfiler");
+	lua.set_current<&Coluster::StopProfiler>("StopProfiler");
+	lua.set_current<&Coluster::GetProfilerStacks>("GetProfilerStacks");
+	lua.set_current<&Coluster::GetProfilerSampleCount>("GetProfilerSampleCount");
+	lua.set_current<&Coluster::GetIdleStats>("GetIdleStats");
+	lua.set_current<&Coluster::GetSwitchStats>("GetSwitchStats");
+	lua.set_current<&Coluster::GetStats>("GetStats");
+	lua.set_current<&Coluster::GetLatencyStats>("GetLatencyStats");
+	lua.set_current<&Coluster::GetSimulationStats>("GetSimulationStats");
+	lua.set_current<&Coluster::ResetLatencyStats>("ResetLatencyStats");
+	lua.set_current<&Coluster::GetTopology>("GetTopology");
+	lua.set_current<&Coluster::GetFrameStats>("GetFrameStats");
+	lua.set_current<&Coluster::TypeCancelToken>("TypeCancelToken");
 	lua.set_current<&Coluster::GetQuota>("GetQuota");
+	lua.set_current<&Coluster::SetMemoryBudget>("SetMemoryBudget");
+	lua.set_current<&Coluster::GetMemoryBudget>("GetMemoryBudget");
+	lua.set_current<&Coluster::GetMemoryUsage>("GetMemoryUsage");
 	lua.set_current<&Coluster::GetStatus>("GetStatus");
 	lua.set_current<&Coluster::GetHardwareConcurrency>("GetHardwareConcurrency");
 	lua.set_current<&Coluster::GetWorkerThreadCount>("GetWorkerThreadCount");
@@ -105,6 +205,10 @@ size_t Coluster::GetWorkerThreadCount() const noexcept {
 	return get_thread_count();
 }
 
+size_t Coluster::GetActiveThreadCount() const noexcept {
+	return workerStatus.load(std::memory_order_acquire) == Status::Running ? get_active_count() : 0;
+}
+
 size_t Coluster::GetTaskCount() const noexcept {
 	return AsyncWorker::get_task_count();
 }
@@ -114,24 +218,82 @@ size_t Coluster::GetHardwareConcurrency() noexcept {
 }
 
 void Coluster::LuaHook(lua_State* L, lua_Debug* ar) {
-	std::string_view name;
+	// coroutines created while profiling inherit the hook, so they drop it by themselves once the profiler stops
+	Coluster* instance = GetProfilingInstance(L);
+	if (instance != nullptr) {
+		instance->SampleStack(L);
+	} else {
+		lua_sethook(L, nullptr, 0, 0);
+	}
+}
 
-	if (lua_getinfo(L, "nS", ar)) {
-		if (ar->name != nullptr) {
-			name = ar->name;
-		} else {
-			name = "function ()";
+Coluster* Coluster::GetProfilingInstance(lua_State* L) noexcept {
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &profilingInstanceKey);
+	Coluster* instance = static_cast<Coluster*>(lua_touserdata(L, -1));
+	lua_pop(L, 1);
+	return instance;
+}
+
+void Coluster::SetProfilingInstance(lua_State* L, Coluster* instance) noexcept {
+	if (instance != nullptr) {
+		lua_pushlightuserdata(L, instance);
+	} else {
+		lua_pushnil(L);
+	}
+
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &profilingInstanceKey);
+}
+
+void Coluster::SampleStack(lua_State* L) {
+	static constexpr int maxDepth = 64;
+	lua_Debug frames[maxDepth];
+	int depth = 0;
+	while (depth < maxDepth && lua_getstack(L, depth, &frames[depth])) {
+		depth++;
+	}
+
+	// collapsed stacks are written from the outermost frame
+	profilerFrames.clear();
+	for (int i = depth - 1; i >= 0; i--) {
+		lua_Debug& ar = frames[i];
+		if (lua_getinfo(L, "nS", &ar)) {
+			if (!profilerFrames.empty()) {
+				profilerFrames.push_back(';');
+			}
+
+			profilerFrames.append(ar.name != nullptr ? ar.name : (*ar.what == 'm' ? "main" : (*ar.what == 'C' ? "[C]" : "?")));
+			if (*ar.what != 'C') {
+				profilerFrames.push_back('@');
+				profilerFrames.append(ar.short_src);
+				profilerFrames.push_back(':');
+				profilerFrames.append(std::to_string(ar.linedefined));
+			}
 		}
 	}
 
-	if (ar->event == LUA_HOOKCALL) {
-	} else if (ar->event == LUA_HOOKRET) {
+	if (!profilerFrames.empty()) {
+		profilerStacks[profilerFrames]++;
+		profilerSampleCount++;
+	}
+}
+
+void Coluster::SetProfilerHook(LuaState lua, int mask, int count) {
+	// threads created afterwards inherit the hook of their creator, existing coroutines are not sampled
+	lua_State* L = lua.get_state();
+	lua_sethook(L, mask == 0 ? nullptr : LuaHook, mask, count);
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+	lua_State* main = lua_tothread(L, -1);
+	lua_pop(L, 1);
+	lua_sethook(main, mask == 0 ? nullptr : LuaHook, mask, count);
+
+	if (cothread.get_state() != nullptr) {
+		lua_sethook(cothread.get_state(), mask == 0 ? nullptr : LuaHook, mask, count);
 	}
 }
 
 void Coluster::lua_initialize(LuaState lua, int index) {
 	lua_State* L = lua.get_state();
-	lua_sethook(L, LuaHook, LUA_MASKCALL | LUA_MASKRET, 0);
 	cothreadRef = lua.make_thread([&](LuaState lua) {
 		cothread = lua;
 	});
@@ -147,10 +309,9 @@ void Coluster::lua_finalize(LuaState lua, int index) {
 		assert(workerStatus.load(std::memory_order_acquire) == Status::Ready);
 	}
 
+	StopProfiler(lua);
 	lua.deref(std::move(cothreadRef));
 	cothread = LuaState(nullptr);
-	lua_State* L = lua.get_state();
-	lua_sethook(L, LuaHook, 0, 0);
 }
 
 // Methods
@@ -168,29 +329,134 @@ std::string_view Coluster::GetStatus() const noexcept {
 	return "Unknown";
 }
 
-Result<bool> Coluster::Start(LuaState lua, size_t threadCount) {
+Result<bool> Coluster::Start(LuaState lua, size_t threadCount, Ref&& options) {
+	// optional settings
+	bool workStealing = false;
+	AsyncWorker::idle_policy_t idlePolicy;
+	idlePolicy.spin_min = 16;
+	idlePolicy.spin_max = 1024;
+	idlePolicy.yield_count = 2;
+	size_t inlineSwitchDepth = 4;
+	ThreadAffinity affinity = ThreadAffinity::None;
+	std::vector<size_t> affinityCpus;
+	size_t maxThreadCount = 0;
+	bool enableAutoResize = false;
+	size_t hostMemoryBudget = 0; // detected from cgroup and available memory if not specified
+	size_t deviceMemoryBudget = 0;
+	bool simulation = false; // deterministic single-threaded scheduling, see iris_async_worker_t::set_simulation()
+	uint64_t simulationSeed = 0;
+
+	if (options) {
+		if (auto value = options.get<bool>(lua, "WorkStealing")) {
+			workStealing = *value;
+		}
+
+		if (auto value = options.get<size_t>(lua, "IdleSpinMin")) {
+			idlePolicy.spin_min = *value;
+		}
+
+		if (auto value = options.get<size_t>(lua, "IdleSpinMax")) {
+			idlePolicy.spin_max = *value;
+		}
+
+		if (auto value = options.get<size_t>(lua, "IdleYieldCount")) {
+			idlePolicy.yield_count = *value;
+		}
+
+		if (auto value = options.get<size_t>(lua, "InlineSwitchDepth")) {
+			inlineSwitchDepth = *value;
+		}
+
+		if (auto value = options.get<std::string>(lua, "Affinity")) {
+			if (*value == "compact") {
+				affinity = ThreadAffinity::Compact;
+			} else if (*value == "scatter") {
+				affinity = ThreadAffinity::Scatter;
+			} else if (*value == "node") {
+				affinity = ThreadAffinity::Node;
+			} else if (*value != "none") {
+				lua.deref(std::move(options));
+				return ResultError("Coluster::Start() -> Affinity must be one of none, compact, scatter and node.");
+			}
+		}
+
+		if (auto value = options.get<size_t>(lua, "MaxThreadCount")) {
+			maxThreadCount = *value;
+		}
+
+		if (auto value = options.get<bool>(lua, "AutoResize")) {
+			enableAutoResize = *value;
+		}
+
+		if (auto value = options.get<size_t>(lua, "HostMemoryBudget")) {
+			hostMemoryBudget = *value;
+		}
+
+		if (auto value = options.get<size_t>(lua, "DeviceMemoryBudget")) {
+			deviceMemoryBudget = *value;
+		}
+
+		if (auto value = options.get<uint64_t>(lua, "SimulationSeed")) {
+			simulation = true;
+			simulationSeed = *value;
+		}
+
+		if (auto value = options.get<std::vector<size_t>>(lua, "AffinityCpus")) {
+			affinityCpus = std::move(*value);
+			if (!affinityCpus.empty()) {
+				affinity = ThreadAffinity::Explicit;
+			}
+		}
+
+		lua.deref(std::move(options));
+	}
+
 	if (AsyncWorker::get_current_thread_index() != ~(size_t)0)
 		return ResultError("Coluster::Start() -> incorrect current thread.");
 
+	if (idlePolicy.spin_min > idlePolicy.spin_max)
+		return ResultError("Coluster::Start() -> IdleSpinMin must not be greater than IdleSpinMax.");
+
 	size_t count = std::thread::hardware_concurrency();
 	if (threadCount != 0) {
 		count = std::min(threadCount, count + static_cast<size_t>(Priority::Count)); // at most hardware_concurrency + Priority_Count threads
 	}
 
 	count = std::max(count, static_cast<size_t>(Priority::Count)); // at least Priority_Count threads
+	// spare threads are spawned but retired, so that Resize() can grow the pool later. MaxThreadCount only lowers the hardware bound
+	size_t capacity = static_cast<size_t>(std::thread::hardware_concurrency()) + static_cast<size_t>(Priority::Count);
+	capacity = std::max(count, maxThreadCount != 0 ? std::min(maxThreadCount, capacity) : capacity);
 
 	Status expected = Status::Ready;
 	if (workerStatus.compare_exchange_strong(expected, Status::Running, std::memory_order_relaxed)) {
-		AsyncWorker::resize(count);
+		threadCapacity = capacity;
+		AsyncWorker::resize(capacity);
+		AsyncWorker::set_work_stealing(workStealing);
+		AsyncWorker::set_simulation(simulation, simulationSeed);
+		enableAutoResize = enableAutoResize && !simulation; // the active count is frozen to keep schedules replayable
+		AsyncWorker::set_idle_policy(idlePolicy);
+		AsyncWorker::set_inline_switch_limit(inlineSwitchDepth);
+		AsyncWorker::SetupAffinity(affinity, std::move(affinityCpus));
 		mainThreadIndex = AsyncWorker::append(std::thread()); // for main thread polling
 		AsyncWorker::start();
+		AsyncWorker::set_active_count(count);
 		AsyncWorker::SetupSharedWarps(count);
+		autoResize.store(enableAutoResize, std::memory_order_release);
+
+		AsyncWorker::MemoryQuota::amount_t budget = AsyncWorker::GetMemoryBudget();
+		hostMemoryBudget = hostMemoryBudget != 0 ? hostMemoryBudget : AsyncWorker::DetectHostMemoryBudget();
+		budget[static_cast<size_t>(QuotaType::HostMemory)] = hostMemoryBudget != 0 ? hostMemoryBudget : budget[static_cast<size_t>(QuotaType::HostMemory)];
+		budget[static_cast<size_t>(QuotaType::DeviceMemory)] = deviceMemoryBudget != 0 ? deviceMemoryBudget : budget[static_cast<size_t>(QuotaType::DeviceMemory)];
+		AsyncWorker::SetMemoryBudget(budget);
 
 		scriptWarp = std::make_unique<Warp>(*this);
 		scriptWarp->BindLuaRoot(cothread);
 		scriptWarp->Acquire();
 
 		AsyncWorker::make_current(mainThreadIndex);
+		if (!simulation) {
+			ScheduleBalance();
+		}
 
 		return true;
 	} else {
@@ -202,19 +468,522 @@ void Coluster::Sleep(size_t milliseconds) {
 	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
 }
 
+Coroutine<void> Coluster::SleepAsync(size_t milliseconds) {
+	co_await coluster::Sleep(std::chrono::milliseconds(milliseconds));
+}
+
+// switch to each shared warp with a timeout, returns the count of warps that responded in time
+Coroutine<Result<size_t>> Coluster::PingWarps(size_t milliseconds) {
+	Warp* currentWarp = Warp::get_current_warp();
+	if (currentWarp == nullptr)
+		co_return ResultError("[ERROR] Coluster::PingWarps() -> Must be called on a warp!");
+
+	[[maybe_unused]] void* coroutineAddress = GetCurrentCoroutineAddress();
+	size_t count = 0;
+	for (auto&& warp : std::vector<std::shared_ptr<Warp>>(sharedWarps)) {
+		if (co_await WithTimeout(Warp::Switch(std::source_location::current(), warp.get()), std::chrono::milliseconds(milliseconds))) {
+			count++;
+		}
+
+		assert(Warp::get_current_warp() == currentWarp);
+		assert(GetCurrentCoroutineAddress() == coroutineAddress);
+	}
+
+	co_return count;
+}
+
+// fan-out state shared by WhenAll/WhenAny, children always complete on the script warp
+struct FanoutState {
+	FanoutState(AsyncWorker& worker, bool any) : event(worker), waitAny(any) {}
+
+	AsyncEvent event;
+	bool waitAny;
+	size_t pending = 0; // unfinished children, plus one for the host until all children started
+	lua_Integer winner = 0;
+	int resultsRef = LUA_NOREF;
+	int threadsRef = LUA_NOREF;
+	std::string error;
+};
+
+// lives in a full userdata held by the entry closure, so it is collected with the child thread even if the routine never finishes
+struct FanoutChild {
+	std::shared_ptr<FanoutState> state;
+	lua_Integer index;
+};
+
+static int FanoutChildCollect(lua_State* T) {
+	static_cast<FanoutChild*>(lua_touserdata(T, 1))->~FanoutChild();
+	return 0;
+}
+
+static void FanoutRelease(lua_State* L, FanoutState& state) {
+	if (--state.pending == 0) {
+		luaL_unref(L, LUA_REGISTRYINDEX, state.threadsRef);
+		state.threadsRef = LUA_NOREF;
+
+		if (!state.waitAny || state.winner == 0) {
+			state.event.notify();
+		}
+	}
+}
+
+static int FanoutFinish(lua_State* T, int status, lua_KContext context) {
+	// each child finishes only once, drop its share of the state right now instead of waiting for gc
+	FanoutChild* child = reinterpret_cast<FanoutChild*>(context);
+	std::shared_ptr<FanoutState> holder = std::move(child->state);
+	FanoutState& state = *holder;
+
+	if (status == LUA_OK || status == LUA_YIELD) {
+		// only the first return value is kept (nil if none), results of WhenAny are dropped once we got the winner
+		if (!state.waitAny || state.winner == 0) {
+			lua_rawgeti(T, LUA_REGISTRYINDEX, state.resultsRef);
+			if (lua_gettop(T) > 0) {
+				lua_pushvalue(T, 1);
+			} else {
+				lua_pushnil(T);
+			}
+
+			lua_rawseti(T, -2, child->index);
+			lua_pop(T, 1);
+
+			if (state.waitAny) {
+				state.winner = child->index;
+				state.event.notify();
+			}
+		}
+	} else if (state.error.empty()) {
+		// error objects are not always strings, and we are outside of any protected call here
+		const char* message = lua_tostring(T, -1);
+		state.error = message != nullptr ? message : "[ERROR] Coluster::Fanout() -> Unknown error!";
+	}
+
+	if (state.threadsRef != LUA_NOREF) {
+		lua_rawgeti(T, LUA_REGISTRYINDEX, state.threadsRef);
+		lua_pushnil(T);
+		lua_rawseti(T, -2, child->index);
+		lua_pop(T, 1);
+	}
+
+	FanoutRelease(T, state);
+	return 0;
+}
+
+static int FanoutEntry(lua_State* T) {
+	lua_KContext context = reinterpret_cast<lua_KContext>(lua_touserdata(T, lua_upvalueindex(1)));
+	return FanoutFinish(T, lua_pcallk(T, lua_gettop(T) - 1, LUA_MULTRET, 0, context, &FanoutFinish), context);
+}
+
+Coroutine<Result<Ref>> Coluster::WhenAll(LuaState lua, Ref&& routines) {
+	return Fanout(lua, std::move(routines), false);
+}
+
+Coroutine<Result<Ref>> Coluster::WhenAny(LuaState lua, Ref&& routines) {
+	return Fanout(lua, std::move(routines), true);
+}
+
+// runs each routine on its own lua thread, and resumes the caller only once
+// a routine is either a function, or a table of { function, args... }
+// a routine yields a single value: its first return value, or nil if it returns nothing
+Coroutine<Result<Ref>> Coluster::Fanout(LuaState lua, Ref&& argRoutines, bool waitAny) {
+	Ref routines(std::move(argRoutines));
+	auto refGuard = lua.ref_guard(routines);
+	lua_State* L = lua.get_state();
+	if (!routines) {
+		co_return ResultError("[ERROR] Coluster::Fanout() -> Invalid routines!");
+	}
+
+	auto state = std::make_shared<FanoutState>(*this, waitAny);
+	lua_newtable(L);
+	state->resultsRef = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_newtable(L);
+	state->threadsRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, routines.get_ref_index());
+	lua_Integer count = static_cast<lua_Integer>(lua_rawlen(L, -1));
+	state->pending = static_cast<size_t>(count) + 1;
+
+	for (lua_Integer i = 1; i <= count; i++) {
+		lua_rawgeti(L, -1, i);
+		int type = lua_type(L, -1);
+		if (type != LUA_TFUNCTION && type != LUA_TTABLE) {
+			lua_pop(L, 1);
+			if (state->error.empty()) {
+				state->error = "[ERROR] Coluster::Fanout() -> Invalid routine!";
+			}
+
+			FanoutRelease(L, *state);
+			continue;
+		}
+
+		lua_State* T = lua_newthread(L);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, state->threadsRef);
+		lua_pushvalue(L, -2);
+		lua_rawseti(L, -2, i);
+		lua_pop(L, 1);
+
+		new (lua_newuserdatauv(T, sizeof(FanoutChild), 0)) FanoutChild { state, i };
+		if (luaL_newmetatable(T, "coluster.FanoutChild")) {
+			lua_pushcfunction(T, &FanoutChildCollect);
+			lua_setfield(T, -2, "__gc");
+		}
+
+		lua_setmetatable(T, -2);
+		lua_pushcclosure(T, &FanoutEntry, 1);
+
+		// FanoutEntry receives the routine followed by its arguments
+		int argCount = 1;
+		if (type == LUA_TFUNCTION) {
+			lua_pushvalue(L, -2);
+			lua_xmove(L, T, 1);
+		} else {
+			int entry = lua_absindex(L, -2);
+			int length = iris::iris_verify_cast<int>(lua_rawlen(L, entry));
+			for (int j = 1; j <= length; j++) {
+				lua_rawgeti(L, entry, j);
+			}
+
+			lua_xmove(L, T, length);
+			argCount = length;
+		}
+
+		// plugin coroutines started by the routine are not nested in us
+		void* coroutineAddress = GetCurrentCoroutineAddress();
+		SetCurrentCoroutineAddress(nullptr);
+		int resultCount = 0;
+		lua_resume(T, L, argCount, &resultCount);
+		SetCurrentCoroutineAddress(coroutineAddress);
+		lua_pop(L, 2);
+	}
+
+	lua_pop(L, 1);
+	FanoutRelease(L, *state);
+
+	if (state->pending != 0 && (!waitAny || state->winner == 0)) {
+		co_await state->event;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, state->resultsRef);
+	luaL_unref(L, LUA_REGISTRYINDEX, state->resultsRef);
+	state->resultsRef = LUA_NOREF;
+
+	if (waitAny) {
+		if (state->winner == 0) {
+			lua_pop(L, 1);
+			co_return ResultError(state->error.empty() ? std::string("[ERROR] Coluster::WhenAny() -> No routines!") : std::move(state->error));
+		}
+
+		lua_rawgeti(L, -1, state->winner);
+		Ref value(luaL_ref(L, LUA_REGISTRYINDEX));
+		lua_pop(L, 1);
+
+		lua_Integer winner = state->winner;
+		co_return lua.make_table([winner, &value](LuaState lua) {
+			lua.set_current("Index", winner);
+			lua.set_current("Value", std::move(value));
+		});
+	} else {
+		if (!state->error.empty()) {
+			lua_pop(L, 1);
+			co_return ResultError(std::move(state->error));
+		}
+
+		co_return Ref(luaL_ref(L, LUA_REGISTRYINDEX));
+	}
+}
+
 AsyncWorker::MemoryQuota::amount_t Coluster::GetQuota() noexcept {
 	return GetMemoryQuotaQueue().GetAmount();
 }
 
+static Ref MakeMemoryTable(LuaState lua, const AsyncWorker::MemoryQuota::amount_t& amount) {
+	return lua.make_table([&amount](LuaState lua) {
+		lua.set_current("HostMemory", amount[static_cast<size_t>(QuotaType::HostMemory)]);
+		lua.set_current("DeviceMemory", amount[static_cast<size_t>(QuotaType::DeviceMemory)]);
+	});
+}
+
+// fields not given in budget are kept, returns the new budget
+Ref Coluster::SetMemoryBudget(LuaState lua, Ref&& budgetRef) {
+	AsyncWorker::MemoryQuota::amount_t budget = AsyncWorker::GetMemoryBudget();
+	if (budgetRef) {
+		if (auto value = budgetRef.get<size_t>(lua, "HostMemory")) {
+			budget[static_cast<size_t>(QuotaType::HostMemory)] = *value;
+		}
+
+		if (auto value = budgetRef.get<size_t>(lua, "DeviceMemory")) {
+			budget[static_cast<size_t>(QuotaType::DeviceMemory)] = *value;
+		}
+
+		lua.deref(std::move(budgetRef));
+	}
+
+	AsyncWorker::SetMemoryBudget(budget);
+	return MakeMemoryTable(lua, budget);
+}
+
+Ref Coluster::GetMemoryBudget(LuaState lua) {
+	return MakeMemoryTable(lua, AsyncWorker::GetMemoryBudget());
+}
+
+Ref Coluster::GetMemoryUsage(LuaState lua) {
+	static constexpr std::string_view categoryNames[] = { "Other", "DataBuffer", "DataPipe", "File", "Texture", "Image", "Buffer" };
+	static_assert(sizeof(categoryNames) / sizeof(categoryNames[0]) == static_cast<size_t>(MemoryCategory::Count), "Mismatched memory categories!");
+
+	return lua.make_table([this](LuaState lua) {
+		for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++) {
+			lua.set_current(categoryNames[i], MakeMemoryTable(lua, AsyncWorker::GetMemoryUsage(static_cast<MemoryCategory>(i))));
+		}
+	});
+}
+
 Result<Ref> Coluster::GetProfile(LuaState lua) {
 	if (scriptWarp) {
+		// chains and acquire samples are only accessed with the script warp held
+		if (Warp::get_current_warp() != scriptWarp.get()) {
+			return ResultError("[ERROR] Coluster::GetProfile() -> Must be called on the script warp!");
+		}
+
 		LuaState::stack_guard_t guard(lua.get_state());
+		scriptWarp->CollectChains(lua);
+		Warp::AcquireStats stats = scriptWarp->GetAcquireStats();
+		scriptWarp->GetProfileTable().set(lua, "acquire", lua.make_table([&stats](LuaState lua) {
+			lua.set_current("Count", stats.count);
+			lua.set_current("P50", stats.p50);
+			lua.set_current("P90", stats.p90);
+			lua.set_current("P99", stats.p99);
+			lua.set_current("Max", stats.max);
+		}));
+
 		return scriptWarp->GetProfileTable().as<Ref>(lua);
 	} else {
 		return ResultError("[ERROR] Cannot GetProfile while coluster is not running!");
 	}
 }
 
+void Coluster::SetChainSampling(size_t interval) noexcept {
+	Warp::SetChainSampling(interval);
+}
+
+Result<bool> Coluster::StartProfiler(LuaState lua, size_t instructionCount) {
+	if (instructionCount == 0 || instructionCount > static_cast<size_t>(std::numeric_limits<int>::max()))
+		return ResultError("[ERROR] Coluster::StartProfiler() -> invalid instruction count.");
+
+	Coluster* instance = GetProfilingInstance(lua.get_state());
+	if (instance != nullptr && instance != this)
+		return ResultError("[ERROR] Coluster::StartProfiler() -> another coluster is profiling.");
+
+	SetProfilingInstance(lua.get_state(), this);
+	SetProfilerHook(lua, LUA_MASKCOUNT, static_cast<int>(instructionCount));
+	return true;
+}
+
+bool Coluster::StopProfiler(LuaState lua) {
+	if (GetProfilingInstance(lua.get_state()) == this) {
+		SetProfilingInstance(lua.get_state(), nullptr);
+		SetProfilerHook(lua, 0, 0);
+		return true;
+	} else {
+		return false;
+	}
+}
+
+// one "frame;frame;frame count" line per stack, which flamegraph.pl and speedscope accept directly
+std::string Coluster::GetProfilerStacks(bool reset) {
+	std::string result;
+	for (auto&& [stack, count] : profilerStacks) {
+		result.append(stack);
+		result.push_back(' ');
+		result.append(std::to_string(count));
+		result.push_back('\n');
+	}
+
+	if (reset) {
+		profilerStacks.clear();
+		profilerSampleCount = 0;
+	}
+
+	return result;
+}
+
+size_t Coluster::GetProfilerSampleCount() const noexcept {
+	return profilerSampleCount;
+}
+
+size_t Coluster::GetChainSampling() const noexcept {
+	return Warp::GetChainSampling();
+}
+
+Ref Coluster::GetIdleStats(LuaState lua) {
+	return lua.make_table([this](LuaState lua) {
+		AsyncWorker::idle_stats_t total;
+		for (size_t i = 0; i < get_thread_count(); i++) {
+			AsyncWorker::idle_stats_t stats = get_idle_stats(i);
+			total.spin_hit_count += stats.spin_hit_count;
+			total.spin_miss_count += stats.spin_miss_count;
+			total.spin_time += stats.spin_time;
+			total.park_count += stats.park_count;
+			total.park_time += stats.park_time;
+
+			lua.set_current(i + 1, lua.make_table([&stats](LuaState lua) {
+				lua.set_current("SpinHitCount", stats.spin_hit_count);
+				lua.set_current("SpinMissCount", stats.spin_miss_count);
+				lua.set_current("SpinTime", stats.spin_time);
+				lua.set_current("ParkCount", stats.park_count);
+				lua.set_current("ParkTime", stats.park_time);
+			}));
+		}
+
+		lua.set_current("SpinHitCount", total.spin_hit_count);
+		lua.set_current("SpinMissCount", total.spin_miss_count);
+		lua.set_current("SpinTime", total.spin_time);
+		lua.set_current("ParkCount", total.park_count);
+		lua.set_current("ParkTime", total.park_time);
+	});
+}
+
+Ref Coluster::GetSwitchStats(LuaState lua) {
+	return lua.make_table([this](LuaState lua) {
+		AsyncWorker::switch_stats_t total;
+		for (size_t i = 0; i < get_thread_count(); i++) {
+			AsyncWorker::switch_stats_t stats = get_switch_stats(i);
+			total.inline_count += stats.inline_count;
+			total.queued_count += stats.queued_count;
+
+			lua.set_current(i + 1, lua.make_table([&stats](LuaState lua) {
+				lua.set_current("InlineCount", stats.inline_count);
+				lua.set_current("QueuedCount", stats.queued_count);
+			}));
+		}
+
+		uint64_t count = total.inline_count + total.queued_count;
+		lua.set_current("InlineCount", total.inline_count);
+		lua.set_current("QueuedCount", total.queued_count);
+		lua.set_current("HitRate", count == 0 ? 0.0 : static_cast<double>(total.inline_count) / static_cast<double>(count));
+	});
+}
+
+static Ref MakeThreadStatsTable(LuaState lua, const AsyncWorker::thread_stats_t& stats) {
+	return lua.make_table([&stats](LuaState lua) {
+		uint64_t executeCount = 0;
+		for (uint64_t count : stats.execute_counts) {
+			executeCount += count;
+		}
+
+		lua.set_current("ExecuteCount", executeCount);
+		lua.set_current("ExecuteCounts", stats.execute_counts); // by priority
+		lua.set_current("DepthPeak", stats.depth_peak);
+		lua.set_current("StealCount", stats.steal_count);
+		lua.set_current("CasRetryCount", stats.cas_retry_count);
+		lua.set_current("PreemptFailureCount", stats.preempt_failure_count);
+		lua.set_current("WakeupNeededCount", stats.wakeup_needed_count);
+		lua.set_current("WakeupIssuedCount", stats.wakeup_issued_count);
+		lua.set_current("RunningTime", stats.running_time);
+		lua.set_current("IdleTime", stats.idle_time);
+	});
+}
+
+Ref Coluster::GetStats(LuaState lua) {
+	return lua.make_table([this](LuaState lua) {
+		AsyncWorker::thread_stats_t total;
+		lua.set_current("Threads", lua.make_table([this, &total](LuaState lua) {
+			for (size_t i = 0; i < get_thread_count(); i++) {
+				AsyncWorker::thread_stats_t stats = get_thread_stats(i);
+				total.execute_counts.resize(stats.execute_counts.size());
+				for (size_t n = 0; n < stats.execute_counts.size(); n++) {
+					total.execute_counts[n] += stats.execute_counts[n];
+				}
+
+				total.depth_peak = std::max(total.depth_peak, stats.depth_peak);
+				total.steal_count += stats.steal_count;
+				total.cas_retry_count += stats.cas_retry_count;
+				total.preempt_failure_count += stats.preempt_failure_count;
+				total.wakeup_needed_count += stats.wakeup_needed_count;
+				total.wakeup_issued_count += stats.wakeup_issued_count;
+				total.running_time += stats.running_time;
+				total.idle_time += stats.idle_time;
+
+				lua.set_current(i + 1, MakeThreadStatsTable(lua, stats));
+			}
+		}));
+
+		lua.set_current("Total", MakeThreadStatsTable(lua, total));
+		lua.set_current("TaskCount", get_task_count());
+		lua.set_current("TimerCount", get_timer_count());
+
+		if (scriptWarp) {
+			lua.set_current("ScriptWarp", scriptWarp->GetStatsTable(lua));
+		}
+
+		lua.set_current("SharedWarps", lua.make_table([this](LuaState lua) {
+			for (size_t i = 0; i < sharedWarps.size(); i++) {
+				lua.set_current(i + 1, sharedWarps[i]->GetStatsTable(lua));
+			}
+		}));
+	});
+}
+
+// percentiles of wait latencies in nanoseconds, keyed by LatencyType names
+Ref Coluster::GetLatencyStats(LuaState lua) {
+	return lua.make_table([](LuaState lua) {
+		for (size_t i = 0; i < static_cast<size_t>(LatencyType::Count); i++) {
+			LatencyStats stats = coluster::GetLatencyStats(static_cast<LatencyType>(i));
+			lua.set_current(GetLatencyTypeName(static_cast<LatencyType>(i)), lua.make_table([&stats](LuaState lua) {
+				lua.set_current("Count", stats.count);
+				lua.set_current("Mean", stats.mean);
+				lua.set_current("P50", stats.p50);
+				lua.set_current("P90", stats.p90);
+				lua.set_current("P99", stats.p99);
+				lua.set_current("P999", stats.p999);
+				lua.set_current("Max", stats.max);
+			}));
+		}
+	});
+}
+
+void Coluster::ResetLatencyStats() {
+	coluster::ResetLatencyStats();
+}
+
+Ref Coluster::GetSimulationStats(LuaState lua) {
+	AsyncWorker::simulation_stats_t stats = AsyncWorker::get_simulation_stats();
+	return lua.make_table([this, &stats](LuaState lua) {
+		lua.set_current("Enabled", AsyncWorker::is_simulation());
+		lua.set_current("Seed", stats.seed);
+		lua.set_current("TaskCount", stats.task_count);
+		lua.set_current("CriticalPath", stats.critical_path);
+		lua.set_current("VirtualTime", stats.virtual_time);
+		lua.set_current("PendingCount", stats.pending_count);
+	});
+}
+
+Ref Coluster::GetTopology(LuaState lua) {
+	std::vector<std::vector<size_t>> nodes = DetectTopology();
+	return lua.make_table([this, &nodes](LuaState lua) {
+		for (size_t i = 0; i < nodes.size(); i++) {
+			lua.set_current(i + 1, nodes[i]);
+		}
+
+		lua.set_current("ThreadNodes", threadNodes);
+	});
+}
+
+Ref Coluster::GetFrameStats(LuaState lua) {
+	iris::iris_default_frame_pool_t::stats_t stats = iris::iris_default_frame_pool_t::get_stats();
+	return lua.make_table([&stats](LuaState lua) {
+		uint64_t total = stats.hit_count + stats.miss_count;
+		lua.set_current("HitCount", stats.hit_count);
+		lua.set_current("MissCount", stats.miss_count);
+		lua.set_current("LargeCount", stats.large_count);
+		lua.set_current("LiveCount", stats.live_count);
+		lua.set_current("BlockCount", stats.block_count);
+		lua.set_current("HitRate", total == 0 ? 0.0 : static_cast<double>(stats.hit_count) / static_cast<double>(total));
+	});
+}
+
+Ref Coluster::TypeCancelToken(LuaState lua) {
+	return lua.make_type<CancelToken>("CancelToken");
+}
+
 Result<bool> Coluster::Post(LuaState lua, Ref&& callback) {
 	if (scriptWarp && callback) {
 		scriptWarp->queue_routine_post([this, callback = std::make_shared<Ref>(std::move(callback))]() mutable {
@@ -229,6 +998,30 @@ Result<bool> Coluster::Post(LuaState lua, Ref&& callback) {
 	}
 }
 
+Result<size_t> Coluster::PostBatch(LuaState lua, Ref&& callbacks) {
+	if (scriptWarp && callbacks) {
+		std::vector<RoutineFunction> routines;
+		for (size_t i = 1; ; i++) {
+			auto callback = callbacks.get<Ref>(lua, i);
+			if (!callback) {
+				break;
+			}
+
+			routines.emplace_back([this, callback = std::make_shared<Ref>(std::move(*callback))]() mutable {
+				assert(cothread);
+				cothread.call<void>(std::move(*callback.get()));
+			});
+		}
+
+		lua.deref(std::move(callbacks));
+		scriptWarp->queue_routine_batch(routines.begin(), routines.end());
+		return routines.size();
+	} else {
+		lua.deref(std::move(callbacks));
+		return ResultError("[ERROR] Cannot Post new routines while coluster is not running!");
+	}
+}
+
 bool Coluster::Stop() {
 	Status expected = Status::Running;
 	if (workerStatus.compare_exchange_strong(expected, Status::Stopping, std::memory_order_relaxed)) {
@@ -545,8 +1338,61 @@ void Coluster::doREPL(lua_State* L) {
 	fflush(stdout);
 }
 
+Result<size_t> Coluster::Resize(size_t threadCount) {
+	if (workerStatus.load(std::memory_order_acquire) != Status::Running) {
+		return ResultError("[ERROR] Cannot Resize while coluster is not running!");
+	}
+
+	if (AsyncWorker::is_simulation()) {
+		return ResultError("[ERROR] Cannot Resize while coluster is simulating!");
+	}
+
+	// 0 for automatic resizing, otherwise the balancer is dropped before the count is applied so it could not overwrite it
+	std::lock_guard<std::mutex> guard(resizeMutex);
+	if (threadCount == 0) {
+		autoResize.store(true, std::memory_order_release);
+	} else {
+		autoResize.store(false, std::memory_order_release);
+		threadBalancer.reset();
+		threadLimiter.reset();
+		set_active_count(std::max(std::min(threadCount, threadCapacity), static_cast<size_t>(Priority::Count)));
+	}
+
+	return get_active_count();
+}
+
+// runs on a timer instead of the polling loop of Join(), which is not running while the console is
+void Coluster::ScheduleBalance() {
+	queue_timer([this]() {
+		if (!AsyncWorker::is_terminated()) {
+			BalanceThreads();
+			ScheduleBalance();
+		}
+	}, std::chrono::milliseconds(20));
+}
+
+// called periodically, retires threads while idle and revives them when tasks are pending
+void Coluster::BalanceThreads() {
+	std::lock_guard<std::mutex> guard(resizeMutex);
+	if (autoResize.load(std::memory_order_acquire)) {
+		if (!threadBalancer) {
+			threadLimiter = std::make_unique<ActiveThreadLimiter>(*this, threadCapacity, static_cast<size_t>(Priority::Count));
+			threadBalancer = std::make_unique<iris::iris_async_balancer_t<ActiveThreadLimiter>>(*threadLimiter, 4u, threadLimiter->get_limit());
+		}
+
+		if (get_task_count() != 0) {
+			threadBalancer->up();
+		} else {
+			threadBalancer->down();
+		}
+	} else if (threadBalancer) {
+		threadBalancer.reset();
+		threadLimiter.reset();
+	}
+}
+
 bool Coluster::Poll(bool pollAsyncTasks) {
-	if (!scriptWarp->join([] {std::this_thread::sleep_for(std::chrono::milliseconds(50)); })) {
+	if (!scriptWarp->join([this] { scriptWarp->wait_yield(std::chrono::milliseconds(50)); })) {
 		return !pollAsyncTasks || AsyncWorker::poll(static_cast<size_t>(Priority::Highest));
 	} else {
 		return false;
@@ -581,7 +1427,12 @@ Result<bool> Coluster::Join(LuaState lua, Ref&& finalizer, bool enableConsole) {
 
 		originalSignalHandler = ::signal(SIGINT, SignalHandler);
 
-		if (enableConsole && lua_stdin_is_tty()) {
+		// the console never polls tasks, which are only run by the polling loop below while simulating
+		if (enableConsole && AsyncWorker::is_simulation()) {
+			fprintf(stderr, "[WARNING] Coluster::Join() -> Console is disabled while simulating.\n");
+		}
+
+		if (enableConsole && !AsyncWorker::is_simulation() && lua_stdin_is_tty()) {
 			doREPL(lua.get_state());
 		} else {
 			scriptWarp->Release();
@@ -606,8 +1457,15 @@ Result<bool> Coluster::Join(LuaState lua, Ref&& finalizer, bool enableConsole) {
 
 	mainThreadIndex = ~size_t(0);
 	AsyncWorker::make_current(mainThreadIndex);
+	do {
+		std::lock_guard<std::mutex> guard(resizeMutex);
+		autoResize.store(false, std::memory_order_release);
+		threadBalancer.reset();
+		threadLimiter.reset();
+	} while (false);
+
 	sharedWarps.clear();
-	while (!scriptWarp->join([] {std::this_thread::sleep_for(std::chrono::milliseconds(50)); })) {}
+	while (!scriptWarp->join([this] { scriptWarp->wait_yield(std::chrono::milliseconds(50)); })) {}
 
 	if (finalizer) {
 		lua.call<void>(std::move(finalizer));